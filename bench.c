@@ -0,0 +1,483 @@
+// Headless layout benchmark. Builds synthetic trees, runs them through yui with a stub
+// backend and prints one JSON object per line for every scenario, engine and pass:
+//
+//   {"scenario":"wide","boxes":10001,"engine":"tree","backend":"callbacks","pass":"end_frame",
+//    "frames":412,"ns_per_box":24.1,"boxes_per_sec":41493775,"peak_bytes":2818048}
+//
+// `peak_bytes` is the most heap yui held at once while the pass ran. `backend` tells
+// bench.exe, which calls the stubs through ctx->config, from bench_bound.exe.
+// Usage: bench.exe [scenario] [scale], scale multiplies the box counts (default 1).
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "yui.h"
+#include "yui_pool.h"
+
+// Every allocation yui makes goes through these so the bench can track its heap
+typedef struct {
+    size_t live;
+    size_t peak;
+} AllocStats;
+
+static AllocStats alloc_stats;
+
+typedef union {
+    size_t size;
+    max_align_t align;
+} AllocHeader;
+
+static void *bench_realloc(void *ptr, size_t size)
+{
+    AllocHeader *header = ptr ? (AllocHeader*)ptr - 1 : NULL;
+    size_t old_size = header ? header->size : 0;
+    header = realloc(header, sizeof(*header) + size);
+    if(!header)
+        return NULL;
+    header->size = size;
+    alloc_stats.live += size - old_size;
+    if(alloc_stats.live > alloc_stats.peak)
+        alloc_stats.peak = alloc_stats.live;
+    return header + 1;
+}
+
+static void *bench_malloc(size_t size)
+{
+    return bench_realloc(NULL, size);
+}
+
+static void bench_free(void *ptr)
+{
+    if(!ptr)
+        return;
+    AllocHeader *header = (AllocHeader*)ptr - 1;
+    alloc_stats.live -= header->size;
+    free(header);
+}
+
+// Roughly what a monospace font does, enough to give text boxes a real size
+static int stub_measure_text(void *font, const char *text, int font_size)
+{
+    (void)font;
+    return (int)strlen(text) * font_size / 2;
+}
+
+// A backend that does next to nothing, so replay measures the dispatch into it
+static uint64_t draw_sink;
+
+static void stub_draw_text(void *font, const char *text, int font_size, int x, int y, yui_Color tint)
+{
+    (void)font; (void)text; (void)tint;
+    draw_sink += (uint64_t)(x + y + font_size);
+}
+
+static void stub_draw_rect(yui_Rect rect, yui_Color color, float roundness)
+{
+    (void)roundness;
+    draw_sink += (uint64_t)(rect.w*rect.h) + color.a;
+}
+
+static void stub_draw_rect_outline(yui_Rect rect, yui_Color color, int border_width)
+{
+    draw_sink += (uint64_t)(rect.w + rect.h + border_width) + color.a;
+}
+
+static void stub_begin_scissor_mode(yui_Rect rect)
+{
+    draw_sink += (uint64_t)rect.x;
+}
+
+static void stub_end_scissor_mode(void)
+{
+    draw_sink += 1;
+}
+
+// bench_bound.exe binds the stubs at compile time, bench.exe calls them through ctx->config
+#ifdef BENCH_BOUND
+#define BACKEND_NAME "bound"
+#define YUI_BACKEND_MEASURE_TEXT        stub_measure_text
+#define YUI_BACKEND_DRAW_TEXT           stub_draw_text
+#define YUI_BACKEND_DRAW_RECT           stub_draw_rect
+#define YUI_BACKEND_DRAW_RECT_OUTLINE   stub_draw_rect_outline
+#define YUI_BACKEND_BEGIN_SCISSOR_MODE  stub_begin_scissor_mode
+#define YUI_BACKEND_END_SCISSOR_MODE    stub_end_scissor_mode
+#else
+#define BACKEND_NAME "callbacks"
+#endif
+
+#define YUI_MALLOC  bench_malloc
+#define YUI_REALLOC bench_realloc
+#define YUI_FREE    bench_free
+#define YUI_IMPLEMENTATION
+#include "yui.h"
+
+#define SCREEN_W 1920
+#define SCREEN_H 1080
+#define DEEP_LEVELS 256
+#define MIN_FRAMES 5
+#define MIN_NS 200000000ull
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t rand_state;
+static uint32_t next_rand(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+typedef struct {
+    const char *name;
+    uint32_t size;
+    void (*build)(yui_Ctx *ctx, uint32_t size);
+    void (*setup)(yui_Ctx *ctx); // once per context, before the first frame
+} Scenario;
+
+typedef struct {
+    const char *name;
+    bool keyed;
+    bool flat;
+    bool skip_unchanged;
+    bool parallel;       // tree engine with a yui_Pool behind config.parallel_for
+} Engine;
+
+static bool keyed; // the root, and the panels of build_panels
+static char (*labels)[16];
+static uint32_t count_labels;
+
+static void open_root(yui_Ctx *ctx, yui_BoxConfig config)
+{
+    if(keyed)
+        yui_open_box_keyed(ctx, "root", 0, config);
+    else
+        yui_open_box(ctx, config);
+}
+
+static void build_wide(yui_Ctx *ctx, uint32_t size)
+{
+    open_root(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+        .padding = { 4, 4, 4, 4 },
+        .background_color = { 30, 30, 30, 255 },
+    });
+    for(uint32_t i = 0; i < size; i++) {
+        yui_open_box(ctx, (yui_BoxConfig){
+            .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIXED },
+            .fixed_height = 20,
+            .margin = { 0, 1, 0, 1 },
+            .background_color = { 60, 60, (uint8_t)i, 255 },
+        });
+        yui_close_box(ctx);
+    }
+    yui_close_box(ctx);
+}
+
+// Chains of DEEP_LEVELS nested boxes side by side
+static void build_deep(yui_Ctx *ctx, uint32_t size)
+{
+    open_root(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_GROW },
+        .content_dir = YUI_CONTENT_LEFT_TO_RIGHT,
+    });
+    for(uint32_t chain = 0; chain < (size + DEEP_LEVELS - 1)/DEEP_LEVELS; chain++) {
+        for(uint32_t level = 0; level < DEEP_LEVELS; level++) {
+            yui_open_box(ctx, (yui_BoxConfig){
+                .sizing = { YUI_BOX_SIZING_FIT, level % 2 ? YUI_BOX_SIZING_GROW : YUI_BOX_SIZING_FIT },
+                .padding = { 1, 1, 1, 1 },
+                .background_color = { (uint8_t)level, 40, 40, 255 },
+            });
+        }
+        yui_open_box(ctx, (yui_BoxConfig){
+            .sizing = { YUI_BOX_SIZING_FIXED, YUI_BOX_SIZING_FIXED },
+            .fixed_width = 8, .fixed_height = 8,
+        });
+        yui_close_box(ctx);
+        for(uint32_t level = 0; level < DEEP_LEVELS; level++)
+            yui_close_box(ctx);
+    }
+    yui_close_box(ctx);
+}
+
+static uint32_t build_mixed_children(yui_Ctx *ctx, uint32_t budget, uint32_t level)
+{
+    uint32_t used = 0;
+    uint32_t count = 1 + next_rand() % 8;
+    for(uint32_t i = 0; i < count && used < budget; i++) {
+        yui_BoxConfig config = {
+            .sizing = { next_rand() % 3, next_rand() % 3 },
+            .content_dir = next_rand() % 2,
+            .fixed_width = 10 + next_rand() % 200,
+            .fixed_height = 10 + next_rand() % 100,
+            .padding = { 2, 2, 2, 2 },
+            .margin = { 1, 1, 1, 1 },
+            .background_color = { (uint8_t)next_rand(), (uint8_t)next_rand(), (uint8_t)next_rand(), 255 },
+            .border_width = next_rand() % 4 == 0,
+        };
+        yui_open_box(ctx, config);
+        used++;
+        if(level < 12 && next_rand() % 3 != 0)
+            used += build_mixed_children(ctx, budget - used, level + 1);
+        yui_close_box(ctx);
+    }
+    return used;
+}
+
+static void build_mixed(yui_Ctx *ctx, uint32_t size)
+{
+    rand_state = 0x9E3779B9u;
+    open_root(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_GROW },
+    });
+    uint32_t used = 0;
+    while(used < size)
+        used += build_mixed_children(ctx, size - used, 0);
+    yui_close_box(ctx);
+}
+
+#define GRID_COLUMNS 8
+static void build_text_grid(yui_Ctx *ctx, uint32_t size)
+{
+    uint32_t rows = (size + GRID_COLUMNS*2 - 1)/(GRID_COLUMNS*2);
+    open_root(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+    });
+    for(uint32_t row = 0; row < rows; row++) {
+        yui_open_box(ctx, (yui_BoxConfig){
+            .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+            .content_dir = YUI_CONTENT_LEFT_TO_RIGHT,
+        });
+        for(uint32_t col = 0; col < GRID_COLUMNS; col++) {
+            yui_open_box(ctx, (yui_BoxConfig){
+                .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+                .padding = { 4, 2, 4, 2 },
+                .background_color = { 50, 50, 50, 255 },
+            });
+            yui_text_box(ctx, labels[(row*GRID_COLUMNS + col) % count_labels],
+                    (yui_TextConfig){ .font_size = 16, .color = YUI_COLOR_WHITE });
+            yui_close_box(ctx);
+        }
+        yui_close_box(ctx);
+    }
+    yui_close_box(ctx);
+}
+
+static yui_StyleId row_style;
+static yui_StyleId cell_style;
+
+// Handles from yui_style_intern last as long as the context, so every frame uses these
+static void setup_text_grid_styled(yui_Ctx *ctx)
+{
+    row_style = yui_style_intern(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+        .content_dir = YUI_CONTENT_LEFT_TO_RIGHT,
+    });
+    cell_style = yui_style_intern(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+        .padding = { 4, 2, 4, 2 },
+        .background_color = { 50, 50, 50, 255 },
+    });
+}
+
+// text_grid with its row and cell styles interned, so boxes skip hashing their config
+static void build_text_grid_styled(yui_Ctx *ctx, uint32_t size)
+{
+    uint32_t rows = (size + GRID_COLUMNS*2 - 1)/(GRID_COLUMNS*2);
+    open_root(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+    });
+    for(uint32_t row = 0; row < rows; row++) {
+        yui_open_box_style(ctx, row_style);
+        for(uint32_t col = 0; col < GRID_COLUMNS; col++) {
+            yui_open_box_style(ctx, cell_style);
+            yui_text_box(ctx, labels[(row*GRID_COLUMNS + col) % count_labels],
+                    (yui_TextConfig){ .font_size = 16, .color = YUI_COLOR_WHITE });
+            yui_close_box(ctx);
+        }
+        yui_close_box(ctx);
+    }
+    yui_close_box(ctx);
+}
+
+#define PANEL_ROWS 16
+// A column of panels of label and value rows where one panel changes every frame, so the
+// frame is never the same but most of it is. Keyed engines move the other panels.
+static void build_panels(yui_Ctx *ctx, uint32_t size)
+{
+    uint32_t count_panels = (size + PANEL_ROWS*3 + 1)/(PANEL_ROWS*3 + 2);
+    yui_TextConfig text = { .font_size = 16, .color = YUI_COLOR_WHITE };
+    open_root(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+    });
+    for(uint32_t panel = 0; panel < count_panels; panel++) {
+        yui_BoxConfig config = {
+            .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+            .padding = { 4, 4, 4, 4 },
+            .margin = { 0, 2, 0, 2 },
+            .background_color = { 40, 40, 50, 255 },
+        };
+        if(keyed)
+            yui_open_box_keyed(ctx, "panel", panel, config);
+        else
+            yui_open_box(ctx, config);
+        if(panel == ctx->frame % count_panels)
+            yui_text_boxf(ctx, text, "Panel %u, frame %u", panel, ctx->frame);
+        else
+            yui_text_boxf(ctx, text, "Panel %u", panel);
+        for(uint32_t row = 0; row < PANEL_ROWS; row++) {
+            yui_open_box(ctx, (yui_BoxConfig){
+                .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIT },
+                .content_dir = YUI_CONTENT_LEFT_TO_RIGHT,
+            });
+            yui_text_box(ctx, labels[row], text);
+            yui_text_box(ctx, labels[(panel*PANEL_ROWS + row) % count_labels], text);
+            yui_close_box(ctx);
+        }
+        yui_close_box(ctx);
+    }
+    yui_close_box(ctx);
+}
+
+static const Scenario scenarios[] = {
+    { "wide",      10000, build_wide, NULL },
+    { "deep",      10240, build_deep, NULL },
+    { "mixed",     10000, build_mixed, NULL },
+    { "text_grid", 10000, build_text_grid, NULL },
+    { "text_grid_styled", 10000, build_text_grid_styled, setup_text_grid_styled },
+    { "panels",    10000, build_panels, NULL },
+};
+
+static const Engine engines[] = {
+    { "tree",          false, false, false, false },
+    { "tree_keyed",    true,  false, false, false },
+    { "flat",          false, true,  false, false },
+    // Every frame after the first is the same, so this is the cost of finding that out
+    { "tree_idle",     true,  false, true,  false },
+    { "tree_parallel", false, false, false, true },
+};
+
+#define BENCH_WORKERS 3
+
+// fit, grow_and_pos and render come from ctx->stats and are part of end_frame,
+// so they report the peak of end_frame
+enum { PASS_BUILD, PASS_FIT, PASS_GROW_AND_POS, PASS_RENDER, PASS_END_FRAME, PASS_REPLAY, PASS_COUNT };
+static const char *pass_names[PASS_COUNT] = { "build", "fit", "grow_and_pos", "render", "end_frame", "replay" };
+
+typedef struct {
+    uint64_t ns[PASS_COUNT];
+    size_t peak[PASS_COUNT];
+} PassTimes;
+
+static void run_frame(yui_Ctx *ctx, const Scenario *scenario, uint32_t size, PassTimes *times)
+{
+    uint64_t start[PASS_COUNT] = {0}, end[PASS_COUNT] = {0};
+
+    alloc_stats.peak = alloc_stats.live;
+    start[PASS_BUILD] = now_ns();
+    yui_begin_frame(ctx, SCREEN_W, SCREEN_H);
+    scenario->build(ctx, size);
+    end[PASS_BUILD] = now_ns();
+    times->peak[PASS_BUILD] = MY_MAX(times->peak[PASS_BUILD], alloc_stats.peak);
+
+    alloc_stats.peak = alloc_stats.live;
+    start[PASS_END_FRAME] = now_ns();
+    yui_end_frame(ctx);
+    end[PASS_END_FRAME] = now_ns();
+    times->peak[PASS_END_FRAME] = MY_MAX(times->peak[PASS_END_FRAME], alloc_stats.peak);
+    times->ns[PASS_FIT]          += ctx->stats.ns[YUI_PASS_FIT];
+    times->ns[PASS_GROW_AND_POS] += ctx->stats.ns[YUI_PASS_GROW_AND_POS];
+    times->ns[PASS_RENDER]       += ctx->stats.ns[YUI_PASS_RENDER];
+    times->peak[PASS_FIT] = times->peak[PASS_GROW_AND_POS] = times->peak[PASS_RENDER] = times->peak[PASS_END_FRAME];
+
+    // The stub backend does next to nothing, so this is the cost of walking the list
+    alloc_stats.peak = alloc_stats.live;
+    start[PASS_REPLAY] = now_ns();
+    yui_replay(ctx, ctx->draw_list.items, ctx->draw_list.count);
+    end[PASS_REPLAY] = now_ns();
+    times->peak[PASS_REPLAY] = MY_MAX(times->peak[PASS_REPLAY], alloc_stats.peak);
+
+    for(int i = 0; i < PASS_COUNT; i++)
+        times->ns[i] += end[i] - start[i];
+}
+
+static void run(const Scenario *scenario, const Engine *engine, uint32_t size)
+{
+    yui_Ctx ctx = {0};
+    ctx.config.measure_text = stub_measure_text;
+    ctx.config.draw_text = stub_draw_text;
+    ctx.config.draw_rect = stub_draw_rect;
+    ctx.config.draw_rect_outline = stub_draw_rect_outline;
+    ctx.config.begin_scissor_mode = stub_begin_scissor_mode;
+    ctx.config.end_scissor_mode = stub_end_scissor_mode;
+    ctx.flat_layout = engine->flat;
+    ctx.skip_unchanged = engine->skip_unchanged;
+    keyed = engine->keyed;
+    yui_Pool *pool = engine->parallel ? yui_pool_create(BENCH_WORKERS) : NULL;
+    if(pool) yui_pool_install(&ctx, pool);
+    if(scenario->setup) scenario->setup(&ctx);
+
+    // Size the arena and the draw list on a first frame that is not measured
+    yui_begin_frame(&ctx, SCREEN_W, SCREEN_H);
+    scenario->build(&ctx, size);
+    uint32_t count_boxes = ctx.boxes.count;
+    ctx.draw_list.cap = 4*count_boxes + 16;
+    ctx.draw_list.items = malloc(ctx.draw_list.cap*sizeof(*ctx.draw_list.items));
+    yui_end_frame(&ctx);
+
+    PassTimes times = {0};
+    uint32_t frames = 0;
+    uint64_t total = 0;
+    while(frames < MIN_FRAMES || total < MIN_NS) {
+        run_frame(&ctx, scenario, size, &times);
+        total = times.ns[PASS_BUILD] + times.ns[PASS_END_FRAME] + times.ns[PASS_REPLAY];
+        frames++;
+    }
+
+    for(int i = 0; i < PASS_COUNT; i++) {
+        double ns_per_box = (double)times.ns[i]/((double)frames*count_boxes);
+        printf("{\"scenario\":\"%s\",\"boxes\":%u,\"engine\":\"%s\",\"backend\":\"%s\",\"pass\":\"%s\",\"frames\":%u,"
+                "\"ns_per_box\":%.2f,\"boxes_per_sec\":%.0f,\"peak_bytes\":%zu}\n",
+                scenario->name, count_boxes, engine->name, BACKEND_NAME, pass_names[i], frames,
+                ns_per_box, ns_per_box > 0 ? 1e9/ns_per_box : 0.0, times.peak[i]);
+    }
+    fflush(stdout);
+
+    free(ctx.draw_list.items);
+    ctx.draw_list.items = NULL;
+    yui_destroy(&ctx);
+    yui_pool_destroy(pool);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    double scale = argc > 2 ? atof(argv[2]) : 1.0;
+    if(filter && strcmp(filter, "all") == 0)
+        filter = NULL;
+
+    count_labels = 4096;
+    labels = malloc(count_labels*sizeof(*labels));
+    for(uint32_t i = 0; i < count_labels; i++)
+        snprintf(labels[i], sizeof(labels[i]), "Item %u", i*7919u % 100000u);
+
+    for(size_t i = 0; i < sizeof(scenarios)/sizeof(scenarios[0]); i++) {
+        if(filter && strcmp(filter, scenarios[i].name) != 0)
+            continue;
+        uint32_t size = (uint32_t)(scenarios[i].size*scale);
+        if(size < 1)
+            size = 1;
+        for(size_t j = 0; j < sizeof(engines)/sizeof(engines[0]); j++)
+            run(&scenarios[i], &engines[j], size);
+    }
+
+    free(labels);
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <assert.h>
 #include "yui.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define TRANSLATE_COLOR(YUI) (Color){ .r=(YUI).r, .g=(YUI).g, .b=(YUI).b, .a =(YUI).a }
 
@@ -39,62 +41,69 @@ void raylib_draw_rect_outline(yui_Rect r, yui_Color color, int border_width)
     DrawRectangleLinesEx((Rectangle){r.x,r.y,r.w,r.h}, border_width, TRANSLATE_COLOR(color));
 }
 
-typedef struct {
-    char *items;
-    uint32_t size;
-    uint32_t allocated;
-} TempAtor;
+#ifdef YUI_TRACE
+// Writes the first frame as a Chrome trace, open it in chrome://tracing or Perfetto
+void trace_to_file(void *user, const yui_TraceEvent *event)
+{
+    static bool first = true;
+    char line[1024];
+    yui_trace_event_json(event, line, sizeof(line));
+    fprintf(user, "%s%s\n", first ? "[" : ",", line);
+    first = false;
+}
+#endif
 
-char *temp_sprintf(TempAtor *ator, const char *fmt, ...)
+// Saves the frame for replay.exe
+void write_snapshot(yui_Ctx *ctx, const char *path)
 {
-    va_list ap;
-    va_start(ap,fmt);
-    va_list copy_ap;
-    va_copy(copy_ap, ap);
-    int needed = vsnprintf(NULL, 0, fmt, copy_ap);
-    va_end(copy_ap);
-
-    if (needed <= 0) {
-        va_end(ap);
-        return NULL;
+    size_t size = yui_write_snapshot(ctx, NULL, 0);
+    void *data = malloc(size);
+    FILE *file = fopen(path, "wb");
+    if(data && file) {
+        yui_write_snapshot(ctx, data, size);
+        fwrite(data, 1, size, file);
     }
-    int required = ator->allocated + needed + 1;
-    if(required > ator->size) {
-        va_end(ap);
-        return NULL;
-    }
-
-    char *dst = &ator->items[ator->allocated];
-
-    vsnprintf(dst, needed + 1, fmt, ap);
-    ator->allocated += (uint32_t)needed + 1;
-    va_end(ap);
+    if(file) fclose(file);
+    free(data);
+}
 
-    return dst;
+// Hands yui the advances raylib measures with, so text is measured without MeasureTextEx
+void register_font(yui_Ctx *ctx, Font *font)
+{
+    yui_GlyphAdvance *advances = malloc(font->glyphCount*sizeof(*advances));
+    if(!advances) return;
+    yui_FontMetrics metrics = {
+        .size = font->baseSize, .ascent = font->baseSize*64, .spacing = 64,
+        .advances = advances, .count_advances = font->glyphCount,
+    };
+    for(int i = 0; i < font->glyphCount; i++) {
+        GlyphInfo glyph = font->glyphs[i];
+        int advance = glyph.advanceX ? glyph.advanceX : (int)font->recs[i].width + glyph.offsetX;
+        advances[i] = (yui_GlyphAdvance){ .codepoint = glyph.value, .advance = advance*64 };
+        if(glyph.value == '?') metrics.default_advance = advance*64;
+    }
+    yui_register_font(ctx, font, &metrics);
+    free(advances);
 }
 
-TempAtor ator = {0};
-char buf[1024];
+yui_DrawCommand draw_commands[1024];
 yui_Color normal_background_color;
 yui_Color hover_background_color;
 yui_Color active_background_color;
-yui_Color background_color;
 yui_Color normal_text_color;
 yui_Color hover_text_color;
 yui_Color active_text_color;
-yui_Color text_color;
 bool  is_active;
+int   count_clicks;
 Font font;
 
 void init(yui_Ctx *ctx)
 {
-    (void)ctx;
     /*Font font = GetFontDefault();*/
     font = LoadFont("./assets/fonts/JetBrainsMono/ttf/JetBrainsMono-Regular.ttf");
     SetTextureFilter(font.texture, TEXTURE_FILTER_BILINEAR);
+    register_font(ctx, &font);
 
-    ator.items = buf;
-    ator.size  = sizeof(buf);
     normal_background_color = (yui_Color) { .r=0xF3, .g=0xF2, .b=0xF1, .a=0xFF };
     hover_background_color  = (yui_Color) { .r=0x10, .g=0x6E, .b=0xBE, .a=0xFF };
     active_background_color = (yui_Color) { .r=0x00, .g=0x5A, .b=0x9E, .a=0xFF };
@@ -102,12 +111,14 @@ void init(yui_Ctx *ctx)
     hover_text_color  = YUI_COLOR_WHITE;
     active_text_color = YUI_COLOR_WHITE;
     is_active = false;
-    text_color = normal_text_color;
-    background_color = normal_background_color;
+    count_clicks = 0;
 }
 
-void draw(yui_Ctx *ctx)
+// Returns false when the screen is already up to date
+bool draw(yui_Ctx *ctx)
 {
+    Vector2 v = GetMousePosition();
+    yui_set_pointer(ctx, v.x, v.y, IsMouseButtonDown(MOUSE_BUTTON_LEFT));
     yui_begin_frame(ctx, GetScreenWidth(), GetScreenHeight());
     yui_Box *top = yui_open_box(ctx, (yui_BoxConfig){ 
         .content_dir = YUI_CONTENT_LEFT_TO_RIGHT, 
@@ -124,13 +135,22 @@ void draw(yui_Ctx *ctx)
             .content_dir = YUI_CONTENT_TOP_TO_BOTTOM,
             .padding = (yui_Bound){ .l = 200, .t = 10, .r = 200, .b = 10 },
         });
-            yui_Box *box = yui_open_box(ctx, (yui_BoxConfig){ 
+            yui_Interaction button = yui_get_interaction_keyed(ctx, "button", 0);
+            if(button.pressed) {
+                is_active = !is_active;
+                count_clicks += 1;
+            }
+            yui_Color text_color = is_active ? active_text_color :
+                button.hovered ? hover_text_color : normal_text_color;
+            yui_open_box_keyed(ctx, "button", 0, (yui_BoxConfig){ 
                     .margin = (yui_Bound){ .b = 10 }, 
-                    .background_color = background_color, });
+                    .background_color = is_active ? active_background_color :
+                        button.hovered ? hover_background_color : normal_background_color, });
                 yui_text_box(ctx, "Hello, A", (yui_TextConfig){ .color = text_color, .font = &font, .font_size = 18 });
             yui_close_box(ctx);
             yui_open_box(ctx, (yui_BoxConfig){ .margin = (yui_Bound){ .b = 10 } });
-                yui_text_box(ctx, "Hello, B", (yui_TextConfig){ .color = normal_text_color, .font = &font, .font_size = 18 });
+                yui_text_boxf(ctx, (yui_TextConfig){ .color = normal_text_color, .font = &font, .font_size = 18 },
+                        "Clicked %d times", count_clicks);
             yui_close_box(ctx);
         yui_close_box(ctx);
         yui_open_box(ctx, (yui_BoxConfig) { 
@@ -139,20 +159,10 @@ void draw(yui_Ctx *ctx)
             yui_text_box(ctx, "TEST", (yui_TextConfig){ .color = normal_text_color, .font = &font, .font_size = 18 });
         yui_close_box(ctx);
     yui_close_box(ctx);
-    yui_end_frame(ctx);
-    Vector2 v = GetMousePosition();
-    yui_Box *hit;
-    hit = yui_hit_test(box, v.x, v.y);
-    if(hit) {
-        if(IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-            is_active = !is_active;
-        }
-        background_color = is_active ? active_background_color : hover_background_color;
-        text_color = is_active ? active_text_color : hover_text_color;
-    } else {
-        background_color = is_active ? active_background_color : normal_background_color;
-        text_color = is_active ? active_text_color : normal_text_color;
-    }
+    bool changed = yui_end_frame(ctx);
+    if(IsKeyPressed(KEY_F12)) write_snapshot(ctx, "frame.yui");
+    yui_replay_damage(ctx, ctx->draw_list.items, ctx->draw_list.count);
+    return changed || ctx->damage.count > 0;
 }
 
 int main(void)
@@ -165,6 +175,18 @@ int main(void)
     ctx->config.draw_rect_outline = raylib_draw_rect_outline;
     ctx->config.begin_scissor_mode = raylib_begin_scissor_mode;
     ctx->config.end_scissor_mode = raylib_end_scissor_mode;
+    ctx->draw_list.items = draw_commands;
+    ctx->draw_list.cap   = sizeof(draw_commands)/sizeof(draw_commands[0]);
+    ctx->draw_list.sort_by_state = true;
+    ctx->damage.enabled = true;
+    ctx->damage.buffer_age  = 2;
+    ctx->damage.clear_color = YUI_COLOR_BLACK;
+    ctx->skip_unchanged = true;
+#ifdef YUI_TRACE
+    FILE *trace = fopen("yui_trace.json", "w");
+    ctx->config.trace = trace ? trace_to_file : NULL;
+    ctx->config.trace_user = trace;
+#endif
 
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(800, 600, "Simple UI");
@@ -173,14 +195,22 @@ int main(void)
 
     while(!WindowShouldClose()) {
         BeginDrawing();
-        ClearBackground(BLACK);
-        ator.allocated = 0;
 
-        draw(ctx);
+        // Sleep in EndDrawing until there is input once nothing is left to redraw
+        if(draw(ctx)) DisableEventWaiting();
+        else EnableEventWaiting();
+#ifdef YUI_TRACE
+        if(ctx->config.trace) {
+            fprintf(ctx->config.trace_user, "]\n");
+            fclose(ctx->config.trace_user);
+            ctx->config.trace = NULL;
+        }
+#endif
 
         EndDrawing();
     }
 
+    yui_destroy(ctx);
     CloseWindow();
 
     return 0;
@@ -0,0 +1,195 @@
+// Headless replay of a frame snapshot written by yui_write_snapshot. Maps the file, lays out
+// and renders its frame over and over without any backend and prints one JSON object per
+// line for every engine and pass, like bench.c:
+//
+//   {"snapshot":"frame.yui","boxes":1234,"engine":"tree","pass":"end_frame","frames":5120,
+//    "ns_per_frame":40211.3}
+//
+// `cold` starts every frame from a new context, so nothing is retained or cached.
+// Usage: replay.exe snapshot [engine] [frames], engine is tree, flat, cold or all (default).
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "yui.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define MIN_FRAMES 5
+#define MIN_NS 200000000ull
+
+typedef struct {
+    const char *name;
+    bool flat;
+    bool cold;
+} Engine;
+
+static const Engine engines[] = {
+    { "tree", false, false },
+    { "flat", true,  false },
+    { "cold", false, true },
+};
+
+enum { PASS_LOAD, PASS_FIT, PASS_GROW_AND_POS, PASS_RENDER, PASS_END_FRAME, PASS_COUNT };
+static const char *pass_names[PASS_COUNT] = { "load", "fit", "grow_and_pos", "render", "end_frame" };
+
+typedef struct {
+    const void *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
+static bool map_file(MappedFile *mapped, const char *path)
+{
+#ifdef _WIN32
+    mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(mapped->file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    mapped->mapping = GetFileSizeEx(mapped->file, &size) && size.QuadPart > 0
+        ? CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    mapped->data = mapped->mapping ? MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if(!mapped->data) {
+        if(mapped->mapping)
+            CloseHandle(mapped->mapping);
+        CloseHandle(mapped->file);
+        return false;
+    }
+    mapped->size = (size_t)size.QuadPart;
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    void *data = fstat(fd, &st) == 0 && st.st_size > 0
+        ? mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+    mapped->data = data;
+    mapped->size = (size_t)st.st_size;
+    return true;
+#endif
+}
+
+static void unmap_file(MappedFile *mapped)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mapped->data);
+    CloseHandle(mapped->mapping);
+    CloseHandle(mapped->file);
+#else
+    munmap((void*)mapped->data, mapped->size);
+#endif
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void init_ctx(yui_Ctx *ctx, const Engine *engine, yui_DrawCommand *commands, uint32_t cap)
+{
+    *ctx = (yui_Ctx){0};
+    ctx->flat_layout = engine->flat;
+    ctx->draw_list.items = commands;
+    ctx->draw_list.cap = cap;
+}
+
+static bool run(const char *path, const MappedFile *mapped, const Engine *engine, uint32_t min_frames)
+{
+    const yui_SnapshotHeader *header = mapped->data;
+    if(mapped->size < sizeof(*header) || header->count_boxes > mapped->size/sizeof(yui_SnapshotBox)) {
+        fprintf(stderr, "%s: not a yui snapshot\n", path);
+        return false;
+    }
+    uint32_t cap = 4*header->count_boxes + 16;
+    yui_DrawCommand *commands = malloc(cap*sizeof(*commands));
+    if(!commands)
+        return false;
+    yui_Ctx ctx;
+    init_ctx(&ctx, engine, commands, cap);
+
+    uint64_t ns[PASS_COUNT] = {0};
+    uint32_t frames = 0;
+    uint64_t total = 0;
+    while(frames < min_frames || total < MIN_NS) {
+        if(engine->cold && frames > 0) {
+            yui_destroy(&ctx);
+            init_ctx(&ctx, engine, commands, cap);
+        }
+        uint64_t start = now_ns();
+        if(!yui_load_snapshot(&ctx, mapped->data, mapped->size, NULL, 0)) {
+            fprintf(stderr, "%s: not a yui snapshot of version %u\n", path, YUI_SNAPSHOT_VERSION);
+            yui_destroy(&ctx);
+            free(commands);
+            return false;
+        }
+        uint64_t loaded = now_ns();
+        yui_end_frame(&ctx);
+        uint64_t end = now_ns();
+        ns[PASS_LOAD]         += loaded - start;
+        ns[PASS_END_FRAME]    += end - loaded;
+        ns[PASS_FIT]          += ctx.stats.ns[YUI_PASS_FIT];
+        ns[PASS_GROW_AND_POS] += ctx.stats.ns[YUI_PASS_GROW_AND_POS];
+        ns[PASS_RENDER]       += ctx.stats.ns[YUI_PASS_RENDER];
+        total += end - start;
+        frames++;
+    }
+
+    for(int i = 0; i < PASS_COUNT; i++) {
+        printf("{\"snapshot\":\"%s\",\"boxes\":%u,\"engine\":\"%s\",\"pass\":\"%s\",\"frames\":%u,"
+                "\"ns_per_frame\":%.1f}\n",
+                path, header->count_boxes, engine->name, pass_names[i], frames, (double)ns[i]/frames);
+    }
+    fflush(stdout);
+
+    yui_destroy(&ctx);
+    free(commands);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s snapshot [tree|flat|cold|all] [frames]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    const char *filter = argc > 2 ? argv[2] : NULL;
+    uint32_t min_frames = argc > 3 ? (uint32_t)atoi(argv[3]) : MIN_FRAMES;
+    if(filter && strcmp(filter, "all") == 0)
+        filter = NULL;
+
+    MappedFile mapped = {0};
+    if(!map_file(&mapped, path)) {
+        fprintf(stderr, "%s: cannot map the file\n", path);
+        return 1;
+    }
+    int result = 0;
+    for(size_t i = 0; i < sizeof(engines)/sizeof(engines[0]); i++) {
+        if(filter && strcmp(filter, engines[i].name) != 0)
+            continue;
+        if(!run(path, &mapped, &engines[i], min_frames)) {
+            result = 1;
+            break;
+        }
+    }
+    unmap_file(&mapped);
+    return result;
+}
@@ -0,0 +1,83 @@
+// A resize redraws the whole screen once, the frame after it is damaged only where it changed.
+// An unchanged frame whose text moved draws the text where it is now.
+#include <stdio.h>
+#include "yui.h"
+
+static yui_DrawCommand commands[256];
+
+static void frame(yui_Ctx *ctx, uint32_t width, uint32_t height, bool highlight)
+{
+    yui_begin_frame(ctx, width, height);
+    yui_open_box(ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_GROW },
+        .background_color = { 0x20, 0x20, 0x20, 0xFF },
+    });
+    for(int i = 0; i < 4; i++) {
+        yui_open_box(ctx, (yui_BoxConfig){
+            .sizing = { YUI_BOX_SIZING_FIXED, YUI_BOX_SIZING_FIXED },
+            .fixed_width = 40, .fixed_height = 20,
+            .background_color = { highlight && i == 2 ? 0xFF : 0x80, 0x80, 0x80, 0xFF },
+        });
+        yui_close_box(ctx);
+    }
+    yui_close_box(ctx);
+    yui_end_frame(ctx);
+}
+
+// Draws the same label from a different buffer every frame, true when the draw list points at it
+static bool moved_label_frame(yui_Ctx *ctx)
+{
+    static char labels[2][16] = { "moved", "moved" };
+    const char *label = labels[ctx->frame % 2];
+    yui_begin_frame(ctx, 400, 300);
+    yui_text_box(ctx, label, (yui_TextConfig){ .font_size = 10 });
+    yui_end_frame(ctx);
+    bool found = false;
+    for(uint32_t i = 0; i < ctx->draw_list.count; i++)
+        if(ctx->draw_list.items[i].kind == YUI_DRAW_TEXT) found = ctx->draw_list.items[i].text.str == label;
+    return found;
+}
+
+static int check(const char *name, bool ok)
+{
+    if(!ok) printf("FAIL %s\n", name);
+    return ok ? 0 : 1;
+}
+
+int main(void)
+{
+    yui_Ctx ctx = {0};
+    ctx.draw_list.items = commands;
+    ctx.draw_list.cap = sizeof(commands)/sizeof(commands[0]);
+    ctx.damage.enabled = true;
+    ctx.damage.buffer_age = 1;
+
+    int failed = 0;
+    frame(&ctx, 400, 300, false);
+    failed += check("first frame is full", ctx.damage.full);
+    frame(&ctx, 400, 300, false);
+    failed += check("same frame is clean", !ctx.damage.full && ctx.damage.count == 0);
+    frame(&ctx, 500, 300, false);
+    failed += check("resize is full", ctx.damage.full);
+    frame(&ctx, 500, 300, false);
+    failed += check("frame after a resize is clean", !ctx.damage.full && ctx.damage.count == 0);
+    frame(&ctx, 500, 300, true);
+    failed += check("one box changed", !ctx.damage.full && ctx.damage.count == 1 &&
+            ctx.damage.rects[0].w == 40 && ctx.damage.rects[0].h == 20);
+
+    yui_destroy(&ctx);
+
+    yui_Ctx reused = {0};
+    reused.draw_list.items = commands;
+    reused.draw_list.cap = sizeof(commands)/sizeof(commands[0]);
+    reused.skip_unchanged = true;
+    failed += check("first label drawn", moved_label_frame(&reused));
+    uint32_t drawn = reused.stats.count_drawn_boxes;
+    failed += check("moved label drawn again", moved_label_frame(&reused) && reused.stats.unchanged);
+    failed += check("reused frame counts its boxes", reused.stats.count_drawn_boxes == drawn &&
+            reused.stats.count_culled_boxes == reused.stats.count_boxes - drawn);
+    yui_destroy(&reused);
+
+    if(failed == 0) printf("damage: ok\n");
+    return failed != 0;
+}
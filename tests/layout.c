@@ -0,0 +1,271 @@
+// Lays random frames out with the tree engine and with flat_layout, and checks both draw
+// the same commands. The trees have wrapped text, scrolling boxes, virtual lists and keys.
+// The tree engine's boxes are checked against the six traversals yui_end_frame used to make,
+// and its draw list against the one it draws during layout with render_in_layout.
+#include <stdio.h>
+#include <string.h>
+#include "yui.h"
+
+#define FRAMES 600
+#define CAP_COMMANDS (1 << 16)
+
+static uint32_t seed;
+
+static uint32_t rnd(void)
+{
+    seed = seed*1103515245u + 12345u;
+    return seed >> 8;
+}
+
+static int measure_text(void *font, const char *text, int font_size)
+{
+    (void)font;
+    int width = 0, line = 0;
+    for(const char *c = text; *c; c++) {
+        line = *c == '\n' ? 0 : line + font_size/2;
+        if(line > width) width = line;
+    }
+    return width;
+}
+
+static const char *texts[] = {
+    "alpha beta gamma delta epsilon zeta eta theta",
+    "x",
+    "short text",
+    "a much longer label that should wrap somewhere in the middle\nand a second paragraph",
+};
+
+static yui_BoxConfig random_config(void)
+{
+    return (yui_BoxConfig){
+        .sizing = { rnd() % 3, rnd() % 3 },
+        .fixed_width = 20 + rnd() % 200, .fixed_height = 10 + rnd() % 100,
+        .padding = { rnd() % 4, 1, 2, rnd() % 3 },
+        .margin = { 1, rnd() % 3, 1, 1 },
+        .content_dir = rnd() % 2,
+        .overflow = { rnd() % 5 == 0 ? YUI_OVERFLOW_SCROLL : rnd() % 7 == 0 ? YUI_OVERFLOW_HIDDEN : 0,
+                      rnd() % 5 == 0 ? YUI_OVERFLOW_SCROLL : 0 },
+        .background_color = { rnd(), rnd(), rnd(), 255 },
+        .border_width = rnd() % 6 == 0 ? 1 : 0,
+    };
+}
+
+// Rows of a scrolling list, only the visible ones are opened
+static void build_list(yui_Ctx *ctx, uint32_t index, bool wrap)
+{
+    yui_BoxConfig config = {
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIXED },
+        .fixed_height = 60 + rnd() % 100,
+        .overflow = { 0, YUI_OVERFLOW_SCROLL },
+        .background_color = { 10, 20, 30, 255 },
+    };
+    yui_Box *box = yui_open_box_keyed(ctx, "list", index, config);
+    if(rnd() % 3 == 0) yui_scroll_by(ctx, box, 0, (int)(rnd() % 40) - 10);
+    uint32_t count = 5 + rnd() % 200;
+    yui_VirtualList list = yui_begin_virtual_list(ctx, count, 14);
+    for(uint32_t i = list.begin; i < list.end; i++) {
+        yui_open_box_keyed(ctx, "row", i, (yui_BoxConfig){
+            .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_FIXED },
+            .fixed_height = 12, .margin = { 0, 1, 0, 1 },
+            .background_color = { (uint8_t)i, 40, 40, 255 },
+        });
+        yui_text_box(ctx, texts[i % 4], (yui_TextConfig){ .font_size = 8, .wrap = wrap && i % 3 == 0 });
+        yui_close_box(ctx);
+    }
+    yui_end_virtual_list(ctx, &list);
+    yui_close_box(ctx);
+}
+
+static void build_tree(yui_Ctx *ctx, int depth, uint32_t index, bool keyed, bool wrap)
+{
+    if(depth == 1 && rnd() % 6 == 0) {
+        build_list(ctx, index, wrap);
+        return;
+    }
+    yui_BoxConfig config = random_config();
+    yui_Box *box = keyed && rnd() % 4 ? yui_open_box_keyed(ctx, "box", index, config) : yui_open_box(ctx, config);
+    if(config.overflow.x_axis == YUI_OVERFLOW_SCROLL || config.overflow.y_axis == YUI_OVERFLOW_SCROLL)
+        yui_scroll_by(ctx, box, (int)(rnd() % 30), (int)(rnd() % 50));
+    uint32_t count = depth < 4 ? rnd() % (depth == 0 ? 10 : 6) : 0;
+    for(uint32_t i = 0; i < count; i++) build_tree(ctx, depth + 1, i, keyed, wrap);
+    if(count == 0 || rnd() % 3 == 0)
+        yui_text_box(ctx, texts[rnd() % 4], (yui_TextConfig){ .font_size = 8 + rnd() % 8, .wrap = wrap && rnd() % 2 });
+    yui_close_box(ctx);
+}
+
+// Frames repeat in threes so retained layouts get reused, and change size and keys in between
+static void frame(yui_Ctx *ctx, int n)
+{
+    seed = 1234 + n/3*7;
+    yui_begin_frame(ctx, 500 + (n % 5)*40, 400 + (n % 3)*30);
+    uint32_t count = 3 + rnd() % 6;
+    for(uint32_t i = 0; i < count; i++) build_tree(ctx, 0, i, n % 4 != 1, n % 8 < 6);
+    yui_end_frame(ctx);
+}
+
+static bool same_commands(const yui_DrawList *a, const yui_DrawList *b)
+{
+    if(a->count != b->count || a->required != b->required) return false;
+    for(uint32_t i = 0; i < a->count; i++) {
+        const yui_DrawCommand *x = &a->items[i], *y = &b->items[i];
+        if(x->kind != y->kind || memcmp(&x->rect, &y->rect, sizeof(x->rect)) != 0 ||
+                memcmp(&x->color, &y->color, sizeof(x->color)) != 0)
+            return false;
+        if(x->kind == YUI_DRAW_TEXT && strcmp(x->text.str, y->text.str) != 0) return false;
+    }
+    return true;
+}
+
+// Reference layout, one recursive walk per pass and axis like the original yui_end_frame.
+// It reads what the engine settled on for the inputs layout corrects: the height of wrapped
+// text and the clamped scroll offsets.
+#define CAP_BOXES (1 << 16)
+
+typedef struct {
+    int filled[2];
+    int content_size[2];
+    int content_pos[2];
+    int padding_pos[2];
+    int cursor[2];
+    int count_grow[2];
+} RefLayout;
+
+static RefLayout ref[CAP_BOXES];
+
+static bool aligned(const yui_Box *box, int a)
+{
+    return box->style->config.content_dir == (a == 0 ? YUI_CONTENT_LEFT_TO_RIGHT : YUI_CONTENT_TOP_TO_BOTTOM);
+}
+
+static yui_BoxSizing sizing(const yui_Box *box, int a)
+{
+    return a == 0 ? box->style->config.sizing.x_axis : box->style->config.sizing.y_axis;
+}
+
+static bool scrolls(const yui_Box *box, int a)
+{
+    return (a == 0 ? box->style->config.overflow.x_axis : box->style->config.overflow.y_axis) == YUI_OVERFLOW_SCROLL;
+}
+
+static void ref_fit(const yui_Box *box, int a)
+{
+    RefLayout *l = &ref[box->id];
+    l->filled[a] = a == 0 && box->lines ? box->fixed_width : 0;
+    l->count_grow[a] = 0;
+    for(const yui_Box *child = box->children.begin; child != NULL; child = child->next) {
+        ref_fit(child, a);
+        int size = ref[child->id].content_size[a] + child->style->padding[a] + child->style->margin[a];
+        if(aligned(box, a)) l->filled[a] += size;
+        else if(size > l->filled[a]) l->filled[a] = size;
+        l->count_grow[a] += sizing(child, a) == YUI_BOX_SIZING_GROW;
+    }
+    if(sizing(box, a) == YUI_BOX_SIZING_FIXED) l->content_size[a] = a == 0 ? box->fixed_width : box->fixed_height;
+    else if(sizing(box, a) == YUI_BOX_SIZING_GROW && scrolls(box, a)) l->content_size[a] = 0;
+    else l->content_size[a] = l->filled[a];
+}
+
+static void ref_grow(const yui_Box *parent, const yui_Box *box, int a)
+{
+    RefLayout *l = &ref[box->id];
+    if(parent && sizing(box, a) == YUI_BOX_SIZING_GROW) {
+        const RefLayout *p = &ref[parent->id];
+        if(aligned(parent, a)) l->content_size[a] += (p->content_size[a] - p->filled[a])/p->count_grow[a];
+        else l->content_size[a] = p->content_size[a];
+    }
+    for(const yui_Box *child = box->children.begin; child != NULL; child = child->next)
+        ref_grow(box, child, a);
+}
+
+static void ref_pos(const yui_Box *parent, const yui_Box *box, int a)
+{
+    RefLayout *l = &ref[box->id];
+    RefLayout *p = &ref[parent->id];
+    int scroll = a == 0 ? parent->scroll.x : parent->scroll.y;
+    int at = aligned(parent, a) ? p->cursor[a] : p->content_pos[a] - scroll;
+    l->padding_pos[a] = at + (a == 0 ? box->style->config.margin.l : box->style->config.margin.t);
+    l->content_pos[a] = l->padding_pos[a] + (a == 0 ? box->style->config.padding.l : box->style->config.padding.t);
+    l->cursor[a] = l->content_pos[a];
+    p->cursor[a] += l->content_size[a] + box->style->padding[a] + box->style->margin[a];
+    if(scrolls(box, a)) l->cursor[a] -= a == 0 ? box->scroll.x : box->scroll.y;
+    else if(sizing(box, a) == YUI_BOX_SIZING_FIXED) return;
+    for(const yui_Box *child = box->children.begin; child != NULL; child = child->next)
+        ref_pos(box, child, a);
+}
+
+// The content and margin boxes follow from the padding box
+static bool same_box(const yui_Box *box)
+{
+    const RefLayout *l = &ref[box->id];
+    const yui_Style *style = box->style;
+    yui_Rect padding = { l->padding_pos[0], l->padding_pos[1],
+                         l->content_size[0] + style->padding[0], l->content_size[1] + style->padding[1] };
+    if(memcmp(&box->layout.padding_box, &padding, sizeof(padding)) != 0) {
+        printf("box %u is at %d %d %d %d, the reference has it at %d %d %d %d\n", box->id,
+                box->layout.padding_box.x, box->layout.padding_box.y, box->layout.padding_box.w, box->layout.padding_box.h,
+                padding.x, padding.y, padding.w, padding.h);
+        return false;
+    }
+    for(const yui_Box *child = box->children.begin; child != NULL; child = child->next)
+        if(!same_box(child)) return false;
+    return true;
+}
+
+// Every box has to be where the reference puts it
+static bool same_layout(yui_Ctx *ctx)
+{
+    yui_Box *root = &ctx->root;
+    if(ctx->stats.count_boxes > CAP_BOXES) return false;
+    memset(ref, 0, sizeof(ref[0])*ctx->stats.count_boxes);
+    for(int a = 0; a < 2; a++) ref_fit(root, a);
+    for(int a = 0; a < 2; a++) ref_grow(NULL, root, a);
+    for(int a = 0; a < 2; a++) {
+        for(const yui_Box *child = root->children.begin; child != NULL; child = child->next)
+            ref_pos(root, child, a);
+    }
+    return same_box(root);
+}
+
+static yui_DrawCommand tree_commands[CAP_COMMANDS];
+static yui_DrawCommand flat_commands[CAP_COMMANDS];
+static yui_DrawCommand inline_commands[CAP_COMMANDS];
+
+int main(void)
+{
+    static yui_Ctx tree, flat, inline_render;
+    tree.config.measure_text = flat.config.measure_text = inline_render.config.measure_text = measure_text;
+    tree.draw_list = (yui_DrawList){ .items = tree_commands, .cap = CAP_COMMANDS };
+    flat.draw_list = (yui_DrawList){ .items = flat_commands, .cap = CAP_COMMANDS };
+    inline_render.draw_list = (yui_DrawList){ .items = inline_commands, .cap = CAP_COMMANDS };
+    flat.flat_layout = true;
+    // Only frames without wrapped text are drawn during layout
+    inline_render.render_in_layout = true;
+
+    int failed = 0;
+    uint32_t count_commands = 0;
+    for(int n = 0; n < FRAMES && !failed; n++) {
+        frame(&tree, n);
+        if(!same_layout(&tree)) {
+            printf("FAIL frame %d is laid out unlike the reference\n", n);
+            failed = 1;
+        }
+        frame(&flat, n);
+        if(!same_commands(&tree.draw_list, &flat.draw_list)) {
+            printf("FAIL frame %d draws %u commands with the tree engine and %u flat\n", n,
+                    tree.draw_list.count, flat.draw_list.count);
+            failed = 1;
+        }
+        frame(&inline_render, n);
+        if(!same_commands(&tree.draw_list, &inline_render.draw_list)) {
+            printf("FAIL frame %d draws %u commands and %u with render_in_layout\n", n,
+                    tree.draw_list.count, inline_render.draw_list.count);
+            failed = 1;
+        }
+        count_commands += tree.draw_list.count;
+    }
+
+    yui_destroy(&tree);
+    yui_destroy(&flat);
+    yui_destroy(&inline_render);
+    if(!failed) printf("layout: ok, %u commands\n", count_commands);
+    return failed;
+}
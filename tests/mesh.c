@@ -0,0 +1,71 @@
+// Lines of text in the mesh are as far apart as the layout put them, and with a white
+// texel in the atlas a frame without scissors is a single batch
+#include <stdio.h>
+#include "yui_mesh.h"
+
+static int atlas;
+static int font;
+
+// Every glyph is an 8x10 quad at the pen
+static void glyph(void *user, void *font, int font_size, uint32_t codepoint, yui_MeshGlyph *glyph)
+{
+    (void)user; (void)font; (void)font_size; (void)codepoint;
+    *glyph = (yui_MeshGlyph){ .x1 = 8, .y1 = 10, .u1 = 1, .v1 = 1, .advance = 10, .texture = &atlas };
+}
+
+static int check(const char *name, bool ok)
+{
+    if(!ok) printf("FAIL %s\n", name);
+    return ok ? 0 : 1;
+}
+
+int main(void)
+{
+    static yui_DrawCommand commands[64];
+    yui_Ctx ctx = {0};
+    ctx.draw_list.items = commands;
+    ctx.draw_list.cap = sizeof(commands)/sizeof(commands[0]);
+    // Lines 16 + 4 + 2 = 22 pixels apart at size 20
+    yui_FontMetrics metrics = { .size = 20, .ascent = 16*64, .descent = 4*64, .line_gap = 2*64, .default_advance = 10*64 };
+    yui_register_font(&ctx, &font, &metrics);
+
+    yui_begin_frame(&ctx, 200, 100);
+    yui_open_box(&ctx, (yui_BoxConfig){
+        .sizing = { YUI_BOX_SIZING_GROW, YUI_BOX_SIZING_GROW },
+        .background_color = { 0x20, 0x20, 0x20, 0xFF },
+    });
+    yui_text_box(&ctx, "a\nb", (yui_TextConfig){ .font = &font, .font_size = 20 });
+    yui_close_box(&ctx);
+    yui_end_frame(&ctx);
+
+    int failed = 0;
+    const yui_DrawCommand *text = NULL;
+    uint32_t count_rects = 0, count_other = 0;
+    for(uint32_t i = 0; i < ctx.draw_list.count; i++) {
+        if(commands[i].kind == YUI_DRAW_TEXT) text = &commands[i];
+        else if(commands[i].kind == YUI_DRAW_RECT && commands[i].roundness == 0) count_rects += 1;
+        else count_other += 1;
+    }
+    // The root and the box behind the text, both square
+    failed += check("two rects and the text", text != NULL && count_rects == 2 && count_other == 0);
+    if(text == NULL) return 1;
+
+    yui_Mesh mesh = { .glyph = glyph, .white_texture = &atlas, .white_u = 0.5f, .white_v = 0.5f, .ctx = &ctx };
+    yui_mesh_build(&mesh, commands, ctx.draw_list.count);
+    // A quad per rect, then one per glyph of "a\nb" with 'b' last
+    uint32_t count_quads = count_rects + 2;
+    failed += check("one batch", mesh.count_batches == 1 && mesh.batches[0].count_indices == mesh.count_indices);
+    failed += check("a quad per rect and glyph", mesh.count_vertices == 4*count_quads && mesh.count_indices == 6*count_quads);
+    failed += check("second line at the line height", yui_line_height(&ctx, &font, 20) == 22 &&
+            mesh.vertices[mesh.count_vertices - 4].y == (float)(text->rect.y + 22));
+
+    mesh.ctx = NULL;
+    yui_mesh_build(&mesh, commands, ctx.draw_list.count);
+    failed += check("second line at the font size without a ctx",
+            mesh.vertices[mesh.count_vertices - 4].y == (float)(text->rect.y + 20));
+
+    yui_mesh_free(&mesh);
+    yui_destroy(&ctx);
+    if(failed == 0) printf("mesh: ok\n");
+    return failed != 0;
+}
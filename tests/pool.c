@@ -0,0 +1,118 @@
+// Lays random frames out serially and through yui_pool with a low parallel_threshold, and
+// checks both draw the same commands. make test-tsan builds it with -fsanitize=thread as
+// well, which needs clang, see the Makefile.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "yui_pool.h"
+
+#define FRAMES 400
+#define CAP_COMMANDS (1 << 16)
+
+static uint32_t seed;
+
+static uint32_t rnd(void)
+{
+    seed = seed*1103515245u + 12345u;
+    return seed >> 8;
+}
+
+static int measure_text(void *font, const char *text, int font_size)
+{
+    (void)font;
+    return (int)strlen(text)*font_size/2;
+}
+
+static const char *texts[] = {
+    "alpha beta gamma delta epsilon zeta eta theta",
+    "x",
+    "short text",
+    "a much longer label that should wrap somewhere in the middle\nand a second paragraph",
+};
+
+static void build_tree(yui_Ctx *ctx, int depth, uint32_t index, bool keyed)
+{
+    yui_BoxConfig config = {
+        .sizing = { rnd() % 3, rnd() % 3 },
+        .fixed_width = 20 + rnd() % 200, .fixed_height = 10 + rnd() % 100,
+        .padding = { rnd() % 4, 1, 2, rnd() % 3 },
+        .margin = { 1, rnd() % 3, 1, 1 },
+        .content_dir = rnd() % 2,
+        .overflow = { rnd() % 5 == 0 ? YUI_OVERFLOW_SCROLL : 0, rnd() % 5 == 0 ? YUI_OVERFLOW_SCROLL : 0 },
+        .background_color = { rnd(), rnd(), rnd(), 255 },
+    };
+    yui_Box *box = keyed ? yui_open_box_keyed(ctx, "box", index, config) : yui_open_box(ctx, config);
+    if(config.overflow.y_axis) yui_scroll_by(ctx, box, 0, (int)(rnd() % 50));
+    uint32_t count = depth < 4 ? rnd() % (depth == 0 ? 12 : 6) : 0;
+    for(uint32_t i = 0; i < count; i++) build_tree(ctx, depth + 1, i, keyed);
+    if(count == 0 || rnd() % 3 == 0)
+        yui_text_box(ctx, texts[rnd() % 4], (yui_TextConfig){ .font_size = 8 + rnd() % 8, .wrap = rnd() % 2 });
+    yui_close_box(ctx);
+}
+
+// Frames repeat in threes so retained layouts get reused, and change size and keys in between
+static void frame(yui_Ctx *ctx, int n)
+{
+    seed = 1234 + n/3*7;
+    yui_begin_frame(ctx, 600 + (n % 5)*30, 500);
+    uint32_t count = 4 + rnd() % 6;
+    for(uint32_t i = 0; i < count; i++) build_tree(ctx, 0, i, n % 4 != 1);
+    yui_end_frame(ctx);
+}
+
+static bool same_commands(const yui_DrawList *a, const yui_DrawList *b)
+{
+    if(a->count != b->count) return false;
+    for(uint32_t i = 0; i < a->count; i++) {
+        const yui_DrawCommand *x = &a->items[i], *y = &b->items[i];
+        if(x->kind != y->kind || memcmp(&x->rect, &y->rect, sizeof(x->rect)) != 0 ||
+                memcmp(&x->color, &y->color, sizeof(x->color)) != 0)
+            return false;
+        if(x->kind == YUI_DRAW_TEXT && strcmp(x->text.str, y->text.str) != 0) return false;
+    }
+    return true;
+}
+
+static yui_DrawCommand serial_commands[CAP_COMMANDS];
+static yui_DrawCommand parallel_commands[CAP_COMMANDS];
+
+int main(int argc, char **argv)
+{
+    uint32_t count_workers = argc > 1 ? (uint32_t)atoi(argv[1]) : 4;
+    yui_Pool *pool = yui_pool_create(count_workers);
+    if(pool == NULL) {
+        printf("FAIL yui_pool_create(%u)\n", count_workers);
+        return 1;
+    }
+    static yui_Ctx serial, parallel;
+    serial.config.measure_text = parallel.config.measure_text = measure_text;
+    serial.draw_list = (yui_DrawList){ .items = serial_commands, .cap = CAP_COMMANDS };
+    parallel.draw_list = (yui_DrawList){ .items = parallel_commands, .cap = CAP_COMMANDS };
+    yui_pool_install(&parallel, pool);
+    parallel.parallel_threshold = 24;
+
+    int failed = 0;
+    uint64_t count_tasks = 0;
+    for(int n = 0; n < FRAMES && !failed; n++) {
+        serial.cull_layout = parallel.cull_layout = (n/50) % 2;
+        frame(&serial, n);
+        frame(&parallel, n);
+        count_tasks += parallel.stats.count_tasks;
+        if(!same_commands(&serial.draw_list, &parallel.draw_list) ||
+                serial.stats.count_relayouts != parallel.stats.count_relayouts) {
+            printf("FAIL frame %d draws %u commands serially and %u in parallel\n", n,
+                    serial.draw_list.count, parallel.draw_list.count);
+            failed = 1;
+        }
+    }
+    if(count_tasks == 0) {
+        printf("FAIL no frame was laid out in parallel\n");
+        failed = 1;
+    }
+
+    yui_destroy(&serial);
+    yui_destroy(&parallel);
+    yui_pool_destroy(pool);
+    if(!failed) printf("pool: ok, %llu tasks\n", (unsigned long long)count_tasks);
+    return failed;
+}
@@ -1,30 +1,188 @@
 #include "yui.h"
+#include "yui_utf8.h"
 #include <assert.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef YUI_MALLOC
+#define YUI_MALLOC malloc
+#endif
+#ifndef YUI_REALLOC
+#define YUI_REALLOC realloc
+#endif
+#ifndef YUI_FREE
+#define YUI_FREE free
+#endif
 
 #define internal static
 
-internal int measure_text(yui_Ctx *ctx, void *font, const char *text, int font_size)
+#define MY_MIN(A, B) ((A) < (B) ? (A) : (B))
+#define MY_MAX(A, B) ((A) > (B) ? (A) : (B))
+
+#define GROW_ARRAY(ARRAY, CAP) do { \
+        void *items = YUI_REALLOC((ARRAY), (size_t)(CAP)*sizeof(*(ARRAY))); \
+        assert(items != NULL && "Out of memory"); \
+        (ARRAY) = items; \
+    } while(0)
+
+#ifndef YUI_CLOCK_NS
+#include <time.h>
+internal uint64_t _clock_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#define YUI_CLOCK_NS _clock_ns
+#endif
+
+#ifdef YUI_TRACE
+internal const char *pass_names[YUI_PASS_COUNT] = {
+    [YUI_PASS_FIT]          = "fit",
+    [YUI_PASS_GROW_AND_POS] = "grow_and_pos",
+    [YUI_PASS_RENDER]       = "render",
+    [YUI_PASS_DAMAGE]       = "damage",
+    [YUI_PASS_SORT]         = "sort",
+    [YUI_PASS_HIT_INDEX]    = "hit_index",
+    [YUI_PASS_CHANGES]      = "changes",
+};
+
+internal void _trace(yui_Ctx *ctx, const char *name, char phase, uint64_t ts, uint64_t dur, const yui_Box *box)
+{
+    if(ctx->config.trace == NULL) return;
+    yui_TraceEvent event = { .name = name, .phase = phase, .ts_ns = ts, .dur_ns = dur, .box = box };
+    ctx->config.trace(ctx->config.trace_user, &event);
+}
+#define TRACE_PASS(CTX, NAME, BEGIN, END) _trace((CTX), (NAME), 'X', (BEGIN), (END) - (BEGIN), NULL)
+#define TRACE_BOX(CTX, BOX) do { if((CTX)->config.trace) _trace((CTX), "box", 'i', YUI_CLOCK_NS(), 0, (BOX)); } while(0)
+
+// JSON string contents, cut short rather than overflowing `size`
+internal void _json_escape(char *dst, size_t size, const char *str)
+{
+    size_t n = 0;
+    for(; *str && n + 7 < size; ++str) {
+        unsigned char c = (unsigned char)*str;
+        if(c == '"' || c == '\\') {
+            dst[n++] = '\\';
+            dst[n++] = (char)c;
+        } else if(c < 0x20) {
+            n += (size_t)snprintf(dst + n, size - n, "\\u%04x", c);
+        } else {
+            dst[n++] = (char)c;
+        }
+    }
+    dst[n] = 0;
+}
+
+int yui_trace_event_json(const yui_TraceEvent *event, char *buffer, size_t size)
 {
-    if(ctx->config.measure_text) return ctx->config.measure_text(font, text, font_size);
-    return 0;
+    // Chrome wants microseconds
+    double ts  = (double)event->ts_ns/1000.0;
+    double dur = (double)event->dur_ns/1000.0;
+    const yui_Box *box = event->box;
+    if(box == NULL)
+        return snprintf(buffer, size, "{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                event->name, event->phase, ts, dur);
+
+    char text[128];
+    _json_escape(text, sizeof(text), box->text ? box->text : "");
+    yui_Rect content = yui_content_box(box);
+    yui_Rect padding = box->layout.padding_box;
+    yui_Rect margin  = yui_margin_box(box);
+    return snprintf(buffer, size,
+            "{\"name\":\"%s\",\"ph\":\"%c\",\"s\":\"t\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{"
+            "\"id\":%u,\"level\":%u,\"text\":\"%s\","
+            "\"content\":[%d,%d,%d,%d],\"padding\":[%d,%d,%d,%d],\"margin\":[%d,%d,%d,%d]}}",
+            event->name, event->phase, ts, box->id, box->level, text,
+            content.x, content.y, content.w, content.h,
+            padding.x, padding.y, padding.w, padding.h,
+            margin.x,  margin.y,  margin.w,  margin.h);
 }
+#else
+#define TRACE_PASS(CTX, NAME, BEGIN, END) ((void)0)
+#define TRACE_BOX(CTX, BOX) ((void)0)
+#endif
+
+// Backend hooks defined when building yui.c, as with YUI_IMPLEMENTATION, are called directly
+// in place of the pointer of the same name in ctx->config, so the compiler can inline them
+// into the render loop. Each one is bound on its own, the others stay runtime callbacks:
+//
+//   #define YUI_BACKEND_DRAW_RECT(RECT, COLOR, ROUNDNESS) my_draw_rect(RECT, COLOR, ROUNDNESS)
+//
+// YUI_BACKEND_MEASURE_TEXT, YUI_BACKEND_MEASURE_TEXTS, YUI_BACKEND_DRAW_TEXT, YUI_BACKEND_DRAW_RECT,
+// YUI_BACKEND_DRAW_RECT_OUTLINE, YUI_BACKEND_BEGIN_SCISSOR_MODE and YUI_BACKEND_END_SCISSOR_MODE
+// take the arguments of the matching yui_*Pfn.
+#ifdef YUI_BACKEND_MEASURE_TEXT
+#define HAS_MEASURE_TEXT(CTX) ((void)(CTX), true)
+#define MEASURE_TEXT(CTX, FONT, TEXT, FONT_SIZE) YUI_BACKEND_MEASURE_TEXT(FONT, TEXT, FONT_SIZE)
+#else
+#define HAS_MEASURE_TEXT(CTX) ((CTX)->config.measure_text != NULL)
+#define MEASURE_TEXT(CTX, FONT, TEXT, FONT_SIZE) (CTX)->config.measure_text(FONT, TEXT, FONT_SIZE)
+#endif
+#ifdef YUI_BACKEND_MEASURE_TEXTS
+#define HAS_MEASURE_TEXTS(CTX) ((void)(CTX), true)
+#define MEASURE_TEXTS(CTX, FONT, FONT_SIZE, TEXTS, COUNT, WIDTHS) YUI_BACKEND_MEASURE_TEXTS(FONT, FONT_SIZE, TEXTS, COUNT, WIDTHS)
+#else
+#define HAS_MEASURE_TEXTS(CTX) ((CTX)->config.measure_texts != NULL)
+#define MEASURE_TEXTS(CTX, FONT, FONT_SIZE, TEXTS, COUNT, WIDTHS) (CTX)->config.measure_texts(FONT, FONT_SIZE, TEXTS, COUNT, WIDTHS)
+#endif
 
 internal void draw_text(yui_Ctx *ctx, void *font, const char *text, int font_size, int x, int y, yui_Color tint)
 {
+#ifdef YUI_BACKEND_DRAW_TEXT
+    (void)ctx;
+    YUI_BACKEND_DRAW_TEXT(font, text, font_size, x, y, tint);
+#else
     if(ctx->config.draw_text)
         ctx->config.draw_text(font, text, font_size, x, y, tint);
+#endif
 }
 
 internal void draw_rect(yui_Ctx *ctx, yui_Rect rect, yui_Color color, float roundness)
 {
+#ifdef YUI_BACKEND_DRAW_RECT
+    (void)ctx;
+    YUI_BACKEND_DRAW_RECT(rect, color, roundness);
+#else
     if(ctx->config.draw_rect)
         ctx->config.draw_rect(rect, color, roundness);
+#endif
 }
 
 internal void draw_rect_outline(yui_Ctx *ctx, yui_Rect rect, yui_Color color, int thickness)
 {
-    if(ctx->config.draw_rect)
+#ifdef YUI_BACKEND_DRAW_RECT_OUTLINE
+    (void)ctx;
+    YUI_BACKEND_DRAW_RECT_OUTLINE(rect, color, thickness);
+#else
+    if(ctx->config.draw_rect_outline)
         ctx->config.draw_rect_outline(rect, color, thickness);
+#endif
+}
+
+internal void begin_scissor_mode(yui_Ctx *ctx, yui_Rect rect)
+{
+#ifdef YUI_BACKEND_BEGIN_SCISSOR_MODE
+    (void)ctx;
+    YUI_BACKEND_BEGIN_SCISSOR_MODE(rect);
+#else
+    if(ctx->config.begin_scissor_mode)
+        ctx->config.begin_scissor_mode(rect);
+#endif
+}
+
+internal void end_scissor_mode(yui_Ctx *ctx)
+{
+#ifdef YUI_BACKEND_END_SCISSOR_MODE
+    (void)ctx;
+    YUI_BACKEND_END_SCISSOR_MODE();
+#else
+    if(ctx->config.end_scissor_mode)
+        ctx->config.end_scissor_mode();
+#endif
 }
 
 internal inline void _add_box_child(yui_Box *parent, yui_Box *child)
@@ -47,289 +205,3077 @@ internal inline void _reset_box(yui_Box *box)
     box->children.count = 0;
     box->parent = NULL;
     box->next   = NULL;
-    box->layout = (yui_BoxLayout){0};
+    box->text   = NULL;
+    box->lines  = 0;
+    box->task   = 0;
+    box->wrap_pending = false;
+    box->hash   = 0;
+    box->key    = 0;
+    box->retained = 0;
+    box->clean  = false;
+    box->scroll = (yui_Point){0};
 }
 
-#define POINT_IN_RECT(R, X, Y) (((R).x <= (X) && (X) < (R).x + (R).w) && ((R).y <= (Y) && (Y) < (R).y + (R).h))
+internal void _append_box_chunk(yui_BoxArena *arena, yui_BoxChunk *chunk)
+{
+    chunk->next = NULL;
+    if(arena->last) arena->last->next = chunk;
+    else arena->first = chunk;
+    arena->last = chunk;
+    if(arena->curr == NULL) {
+        arena->curr = chunk;
+        arena->curr_count = 0;
+    }
+    arena->capacity += chunk->cap;
+}
 
-yui_Box *yui_hit_test(yui_Box *box, int x, int y)
+// The chunk header and its boxes live in one block, aligned for yui_Box.
+#define BOX_CHUNK_HEADER_SIZE ((sizeof(yui_BoxChunk) + _Alignof(yui_Box) - 1) & ~(_Alignof(yui_Box) - 1))
+
+internal yui_BoxChunk *_alloc_box_chunk(yui_BoxArena *arena)
 {
-    if(POINT_IN_RECT(box->layout.padding_box, x, y)) {
-        for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
-            yui_Box *result = yui_hit_test(child, x, y);
-            if(result != NULL)
-                return result;
+    uint32_t cap = arena->chunk_cap ? arena->chunk_cap : YUI_BOX_CHUNK_CAP;
+    char *memory = YUI_MALLOC(BOX_CHUNK_HEADER_SIZE + (size_t)cap*sizeof(yui_Box));
+    assert(memory != NULL && "Out of memory");
+    yui_BoxChunk *chunk = (yui_BoxChunk*)memory;
+    chunk->items = (yui_Box*)(memory + BOX_CHUNK_HEADER_SIZE);
+    chunk->cap   = cap;
+    chunk->owned = true;
+    _append_box_chunk(arena, chunk);
+    return chunk;
+}
+
+internal yui_Box *_alloc_box(yui_BoxArena *arena)
+{
+    while(arena->curr == NULL || arena->curr_count >= arena->curr->cap) {
+        if(arena->curr && arena->curr->next) {
+            arena->curr = arena->curr->next;
+            arena->curr_count = 0;
+        } else {
+            yui_BoxChunk *chunk = _alloc_box_chunk(arena);
+            arena->curr = chunk;
+            arena->curr_count = 0;
         }
-        return box;
     }
-    return NULL;
+    yui_Box *box = &arena->curr->items[arena->curr_count++];
+    arena->count += 1;
+    if(arena->count > arena->high_water) arena->high_water = arena->count;
+    return box;
 }
 
-void yui_begin_frame(yui_Ctx *ctx, uint32_t root_width, uint32_t root_height)
+internal inline void _rewind_boxes(yui_BoxArena *arena)
 {
-    ctx->count_boxes = 0;
-    yui_Box *root = &ctx->root;
-    _reset_box(root);
-    root->config.sizing.x_axis = YUI_BOX_SIZING_FIXED;
-    root->config.sizing.y_axis = YUI_BOX_SIZING_FIXED;
-    root->config.fixed_width  = root_width;
-    root->config.fixed_height = root_height;
-    root->id = 0;
-    ctx->curr = root;
+    arena->curr = arena->first;
+    arena->curr_count = 0;
+    arena->count = 0;
 }
 
-yui_Box *yui_open_box(yui_Ctx *ctx, yui_BoxConfig config)
+void yui_reserve_boxes(yui_Ctx *ctx, uint32_t count)
 {
-    assert(ctx->count_boxes + 1 <= YUI_BOXES_CAP);
-    ctx->level += 1;
-    yui_Box *prev = ctx->curr;
-    int id = ctx->count_boxes + 1;
-    yui_Box *curr = &ctx->boxes[ctx->count_boxes++];
-    _reset_box(curr);
-    curr->id = id;
-    curr->level = ctx->level;
-    curr->config = config;
-    _add_box_child(prev, curr);
-    ctx->curr = curr;
-    return curr;
+    while(ctx->boxes.capacity < count)
+        _alloc_box_chunk(&ctx->boxes);
 }
 
-void yui_close_box(yui_Ctx *ctx)
+void yui_supply_boxes(yui_Ctx *ctx, void *memory, size_t size)
 {
-    ctx->level -= 1;
-    ctx->curr = ctx->curr->parent;
+    assert(((uintptr_t)memory & (_Alignof(yui_BoxChunk) - 1)) == 0 && "Supplied memory is not aligned");
+    if(size < BOX_CHUNK_HEADER_SIZE + sizeof(yui_Box)) return;
+    yui_BoxChunk *chunk = memory;
+    chunk->items = (yui_Box*)((char*)memory + BOX_CHUNK_HEADER_SIZE);
+    chunk->cap   = (uint32_t)((size - BOX_CHUNK_HEADER_SIZE)/sizeof(yui_Box));
+    chunk->owned = false;
+    _append_box_chunk(&ctx->boxes, chunk);
 }
 
-void yui_text_box(yui_Ctx *ctx, const char *text, yui_TextConfig text_config)
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME  0x100000001b3ull
+
+internal inline uint64_t _hash_mix(uint64_t h, uint64_t v)
 {
-    yui_BoxConfig config = {0};
-    config.text = text_config;
-    config.sizing.x_axis = YUI_BOX_SIZING_FIXED;
-    config.sizing.y_axis = YUI_BOX_SIZING_FIXED;
-    int height = config.text.font_size;
-    int width  = measure_text(ctx, config.text.font, text, height);
-    config.fixed_width  = width;
-    config.fixed_height = height;
-    yui_open_box(ctx, config);
-    ctx->curr->text = text;
-    yui_close_box(ctx);
+    h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    return h;
 }
 
-#include <stdio.h>
-internal void dumb_box(yui_Box *box, const char *label)
+internal uint64_t _hash_str(uint64_t h, const char *str)
 {
-    if(box->text) {
-        printf("%s: %*s [%d] \"%s\" content[x=%d y=%d w=%d h=%d] padding[x=%d y=%d w=%d h=%d] margin[x=%d y=%d w=%d h=%d] cursor[x=%d y=%d]\n", 
-                label, box->level*4, "", box->id, box->text, 
-                box->layout.content_box.x, box->layout.content_box.y, 
-                box->layout.content_box.w, box->layout.content_box.h,
-                box->layout.padding_box.x, box->layout.padding_box.y, 
-                box->layout.padding_box.w, box->layout.padding_box.h,
-                box->layout.margin_box.x, box->layout.margin_box.y, 
-                box->layout.margin_box.w, box->layout.margin_box.h,
-                box->layout.cursor_x, box->layout.cursor_y
-                );
-    } else {
-        printf("%s: %*s [%d] content[x=%d y=%d w=%d h=%d] padding[x=%d y=%d w=%d h=%d] margin[x=%d y=%d w=%d h=%d] cursor[x=%d y=%d]\n", 
-                label, box->level*4, "", box->id,
-                box->layout.content_box.x, box->layout.content_box.y, 
-                box->layout.content_box.w, box->layout.content_box.h,
-                box->layout.padding_box.x, box->layout.padding_box.y, 
-                box->layout.padding_box.w, box->layout.padding_box.h,
-                box->layout.margin_box.x, box->layout.margin_box.y, 
-                box->layout.margin_box.w, box->layout.margin_box.h,
-                box->layout.cursor_x, box->layout.cursor_y
-                );
+    if(str == NULL) return h;
+    for(; *str; ++str) {
+        h ^= (uint8_t)*str;
+        h *= FNV_PRIME;
     }
+    return h;
 }
 
-#define MY_MIN(A, B) ((A) < (B) ? (A) : (B))
-#define MY_MAX(A, B) ((A) > (B) ? (A) : (B))
+internal uint64_t _hash_config(const yui_BoxConfig *c)
+{
+    uint64_t h = FNV_OFFSET;
+    h = _hash_mix(h, (uint64_t)c->overflow.x_axis | (uint64_t)c->overflow.y_axis << 8 |
+            (uint64_t)c->sizing.x_axis << 16 | (uint64_t)c->sizing.y_axis << 24 | (uint64_t)c->content_dir << 32 |
+            (uint64_t)c->text.wrap << 40);
+    h = _hash_mix(h, (uint32_t)c->fixed_width  | (uint64_t)(uint32_t)c->fixed_height << 32);
+    h = _hash_mix(h, (uint32_t)c->padding.l | (uint64_t)(uint32_t)c->padding.t << 32);
+    h = _hash_mix(h, (uint32_t)c->padding.r | (uint64_t)(uint32_t)c->padding.b << 32);
+    h = _hash_mix(h, (uint32_t)c->margin.l  | (uint64_t)(uint32_t)c->margin.t  << 32);
+    h = _hash_mix(h, (uint32_t)c->margin.r  | (uint64_t)(uint32_t)c->margin.b  << 32);
+    h = _hash_mix(h, (uint64_t)(uintptr_t)c->text.font);
+    h = _hash_mix(h, (uint32_t)c->text.font_size |
+            (uint64_t)c->text.color.r << 32 | (uint64_t)c->text.color.g << 40 |
+            (uint64_t)c->text.color.b << 48 | (uint64_t)c->text.color.a << 56);
+    h = _hash_mix(h, (uint64_t)c->background_color.r | (uint64_t)c->background_color.g << 8 |
+            (uint64_t)c->background_color.b << 16 | (uint64_t)c->background_color.a << 24);
+    union { float f; uint32_t u; } roundness = { .f = c->roundness };
+    h = _hash_mix(h, roundness.u | (uint64_t)(uint32_t)c->border_width << 32);
+    h = _hash_mix(h, (uint64_t)c->border_color.r | (uint64_t)c->border_color.g << 8 |
+            (uint64_t)c->border_color.b << 16 | (uint64_t)c->border_color.a << 24);
+    return h;
+}
 
-internal void _compute_fit_sizing_on(yui_Ctx *ctx, yui_Box *parent, yui_Box *box, bool x_axis)
+internal inline bool _colors_equal(yui_Color a, yui_Color b)
 {
-    int content_size = 0;
-    yui_BoxSizing sizing = x_axis ? box->config.sizing.x_axis : box->config.sizing.y_axis;
-    yui_ContentDirection aligned_direction = YUI_CONTENT_LEFT_TO_RIGHT;
-    if(!x_axis) aligned_direction = YUI_CONTENT_TOP_TO_BOTTOM;
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
 
-    for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
-        _compute_fit_sizing_on(ctx, box, child, x_axis);
-        int child_margin_box_size = 0;
-        if(x_axis) {
-            child_margin_box_size = child->layout.content_box.w + child->config.padding.l + child->config.padding.r +
-                child->config.margin.l + child->config.margin.r;
-        } else {
-            child_margin_box_size = child->layout.content_box.h + child->config.padding.t + child->config.padding.b +
-                child->config.margin.t + child->config.margin.b;
-        }
+internal inline bool _bounds_equal(yui_Bound a, yui_Bound b)
+{
+    return a.l == b.l && a.t == b.t && a.r == b.r && a.b == b.b;
+}
 
-        if(box->config.content_dir == aligned_direction) {
-            content_size += child_margin_box_size;
-        } else {
-            content_size  = MY_MAX(content_size, child_margin_box_size);
+// Field by field, padding bytes of configs passed by value are not zeroed
+internal bool _configs_equal(const yui_BoxConfig *a, const yui_BoxConfig *b)
+{
+    union { float f; uint32_t u; } ra = { .f = a->roundness }, rb = { .f = b->roundness };
+    return a->overflow.x_axis == b->overflow.x_axis && a->overflow.y_axis == b->overflow.y_axis &&
+        a->sizing.x_axis == b->sizing.x_axis && a->sizing.y_axis == b->sizing.y_axis &&
+        a->content_dir == b->content_dir && a->fixed_width == b->fixed_width && a->fixed_height == b->fixed_height &&
+        _bounds_equal(a->padding, b->padding) && _bounds_equal(a->margin, b->margin) &&
+        _colors_equal(a->background_color, b->background_color) && ra.u == rb.u &&
+        a->border_width == b->border_width && _colors_equal(a->border_color, b->border_color) &&
+        a->text.font == b->text.font && a->text.font_size == b->text.font_size &&
+        _colors_equal(a->text.color, b->text.color) && a->text.wrap == b->text.wrap;
+}
+
+internal yui_Style *_alloc_style(yui_StyleTable *table)
+{
+    if(table->curr == NULL || table->used == table->curr->cap) {
+        yui_StyleChunk *next = table->curr ? table->curr->next : table->first;
+        if(next == NULL) {
+            next = YUI_MALLOC(sizeof(*next) + YUI_STYLE_CHUNK_CAP*sizeof(yui_Style));
+            assert(next != NULL && "Out of memory");
+            next->cap = YUI_STYLE_CHUNK_CAP;
+            next->next = NULL;
+            if(table->curr) table->curr->next = next;
+            else table->first = next;
         }
+        table->curr = next;
+        table->used = 0;
+    }
+    return &table->curr->items[table->used++];
+}
 
-        if(x_axis) {
-            if(child->config.sizing.x_axis == YUI_BOX_SIZING_GROW) {
-                box->layout.count_children_with_grow_box_on_x_axis += 1;
-            }
-        } else {
-            if(child->config.sizing.y_axis == YUI_BOX_SIZING_GROW) {
-                box->layout.count_children_with_grow_box_on_y_axis += 1;
+internal void _rebuild_style_slots(yui_StyleTable *table, uint32_t count_slots)
+{
+    YUI_FREE(table->slots);
+    table->slots = YUI_MALLOC(count_slots*sizeof(*table->slots));
+    assert(table->slots != NULL && "Out of memory");
+    for(uint32_t i = 0; i < count_slots; ++i) table->slots[i] = 0;
+    table->count_slots = count_slots;
+    for(uint32_t i = 1; i < table->count; ++i) {
+        uint32_t slot = (uint32_t)table->items[i]->hash & (count_slots - 1);
+        while(table->slots[slot]) slot = (slot + 1) & (count_slots - 1);
+        table->slots[slot] = i;
+    }
+}
+
+// Index of the style with `config`, which is added when there is none
+internal uint32_t _intern_style(yui_StyleTable *table, const yui_BoxConfig *config, uint64_t hash)
+{
+    if(table->count_slots == 0 || table->count*2 >= table->count_slots)
+        _rebuild_style_slots(table, table->count_slots ? table->count_slots*2 : 64);
+
+    uint32_t slot = (uint32_t)hash & (table->count_slots - 1);
+    while(table->slots[slot]) {
+        uint32_t index = table->slots[slot];
+        const yui_Style *style = table->items[index];
+        if(style->hash == hash && _configs_equal(&style->config, config)) return index;
+        slot = (slot + 1) & (table->count_slots - 1);
+    }
+
+    if(table->count == 0) table->count = 1;
+    if(table->count >= table->cap) {
+        table->cap = table->cap ? table->cap*2 : 64;
+        GROW_ARRAY(table->items, table->cap);
+    }
+    yui_Style *style = _alloc_style(table);
+    const yui_BoxConfig *c = config;
+    *style = (yui_Style){
+        .config = *c,
+        .hash = hash,
+        .lead_margin = { c->margin.l, c->margin.t },
+        .lead    = { c->margin.l + c->padding.l, c->margin.t + c->padding.t },
+        .padding = { c->padding.l + c->padding.r, c->padding.t + c->padding.b },
+        .margin  = { c->margin.l + c->margin.r, c->margin.t + c->margin.b },
+    };
+    uint32_t index = table->count++;
+    table->items[index] = style;
+    table->slots[slot] = index;
+    return index;
+}
+
+// Styles of the last frame's configs are not kept, their boxes are gone
+internal void _clear_style_table(yui_StyleTable *table)
+{
+    if(table->count <= 1) return;
+    table->curr = table->first;
+    table->used = 0;
+    table->count = 1;
+    for(uint32_t i = 0; i < table->count_slots; ++i) table->slots[i] = 0;
+}
+
+internal void _free_style_table(yui_StyleTable *table)
+{
+    yui_StyleChunk *chunk = table->first;
+    while(chunk) {
+        yui_StyleChunk *next = chunk->next;
+        YUI_FREE(chunk);
+        chunk = next;
+    }
+    YUI_FREE(table->items);
+    YUI_FREE(table->slots);
+    *table = (yui_StyleTable){0};
+}
+
+yui_StyleId yui_style_intern(yui_Ctx *ctx, yui_BoxConfig config)
+{
+    return _intern_style(&ctx->styles, &config, _hash_config(&config));
+}
+
+// The style a config passed by value shares with the frame's other boxes
+internal const yui_Style *_frame_style(yui_Ctx *ctx, const yui_BoxConfig *config)
+{
+    uint32_t index = _intern_style(&ctx->frame_styles, config, _hash_config(config));
+    return ctx->frame_styles.items[index];
+}
+
+// What the root's config would be, its size is set in yui_begin_frame
+internal const yui_Style root_style = {
+    .config = { .sizing = { YUI_BOX_SIZING_FIXED, YUI_BOX_SIZING_FIXED } },
+};
+
+#define TEXT_CACHE_NIL UINT32_MAX
+
+internal void _text_cache_unlink(yui_TextCache *cache, uint32_t index)
+{
+    yui_TextCacheEntry *entry = &cache->items[index];
+    if(entry->prev != TEXT_CACHE_NIL) cache->items[entry->prev].next = entry->next;
+    else cache->head = entry->next;
+    if(entry->next != TEXT_CACHE_NIL) cache->items[entry->next].prev = entry->prev;
+    else cache->tail = entry->prev;
+}
+
+internal void _text_cache_push_front(yui_TextCache *cache, uint32_t index)
+{
+    yui_TextCacheEntry *entry = &cache->items[index];
+    entry->prev = TEXT_CACHE_NIL;
+    entry->next = cache->head;
+    if(cache->head != TEXT_CACHE_NIL) cache->items[cache->head].prev = index;
+    else cache->tail = index;
+    cache->head = index;
+}
+
+internal void _text_cache_unbucket(yui_TextCache *cache, uint32_t index)
+{
+    uint32_t *link = &cache->buckets[cache->items[index].hash & (cache->count_buckets - 1)];
+    while(*link != index) link = &cache->items[*link].bucket_next;
+    *link = cache->items[index].bucket_next;
+}
+
+internal void _text_cache_clear(yui_TextCache *cache)
+{
+    cache->count = 0;
+    cache->head = cache->tail = TEXT_CACHE_NIL;
+    for(uint32_t i = 0; i < cache->count_buckets; ++i) cache->buckets[i] = TEXT_CACHE_NIL;
+}
+
+internal yui_Font *_find_font(yui_Ctx *ctx, void *font)
+{
+    for(uint32_t i = 0; i < ctx->fonts.count; ++i)
+        if(ctx->fonts.items[i].font == font) return &ctx->fonts.items[i];
+    return NULL;
+}
+
+internal int32_t _glyph_advance(const yui_Font *font, uint32_t codepoint)
+{
+    if(codepoint < 128) return font->ascii[codepoint];
+    uint32_t lo = 0, hi = font->metrics.count_advances;
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo)/2;
+        if(font->advances[mid].codepoint < codepoint) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < font->metrics.count_advances && font->advances[lo].codepoint == codepoint
+        ? font->advances[lo].advance : font->metrics.default_advance;
+}
+
+internal int32_t _kerning(const yui_Font *font, uint32_t left, uint32_t right)
+{
+    if(font->metrics.count_kerning == 0) return 0;
+    if(left < 128 && !(font->kerned[left >> 3] & (1u << (left & 7)))) return 0;
+    uint64_t key = (uint64_t)left << 32 | right;
+    uint32_t lo = 0, hi = font->metrics.count_kerning;
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo)/2;
+        if(((uint64_t)font->kerning[mid].left << 32 | font->kerning[mid].right) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < font->metrics.count_kerning && font->kerning[lo].left == left && font->kerning[lo].right == right
+        ? font->kerning[lo].adjust : 0;
+}
+
+// Width of the widest line in 26.6 fixed point, scaled from the size of the metrics
+internal int _measure_native(const yui_Font *font, const char *text, int font_size)
+{
+    if(text == NULL || font->metrics.size <= 0) return 0;
+    const unsigned char *s = (const unsigned char *)text;
+    int64_t widest = 0;
+    for(;;) {
+        int64_t sum = 0;
+        int64_t glyphs = 0;
+        uint32_t prev = 0;
+        while(*s && *s != '\n') {
+            // Runs of ASCII without kerning are a lookup per byte
+            if(font->metrics.count_kerning == 0) {
+                const unsigned char *run = s;
+                while(*s && *s < 0x80 && *s != '\n') sum += font->ascii[*s++];
+                glyphs += s - run;
+                if(!*s || *s == '\n') break;
             }
+            uint32_t codepoint = yui_decode_utf8(&s);
+            if(glyphs > 0) sum += _kerning(font, prev, codepoint);
+            sum += _glyph_advance(font, codepoint);
+            glyphs += 1;
+            prev = codepoint;
         }
+        int64_t width = sum*font_size/font->metrics.size + (glyphs > 0 ? (glyphs - 1)*font->metrics.spacing : 0);
+        widest = MY_MAX(widest, width);
+        if(*s != '\n') break;
+        s++;
     }
+    return (int)((widest + 63)/64);
+}
 
-    if(sizing == YUI_BOX_SIZING_FIXED) {
-        if(x_axis) {
-            box->layout.content_box.w = box->config.fixed_width;
-        } else {
-            box->layout.content_box.h = box->config.fixed_height;
+// Distance between the lines of wrapped text, the font size without metrics
+internal int _line_height(yui_Ctx *ctx, void *font, int font_size)
+{
+    const yui_Font *f = _find_font(ctx, font);
+    if(f == NULL || f->metrics.size <= 0) return font_size;
+    int64_t height = (int64_t)(f->metrics.ascent + f->metrics.descent + f->metrics.line_gap)*font_size;
+    int64_t unit = (int64_t)f->metrics.size*64;
+    return (int)((height + unit - 1)/unit);
+}
+
+internal int _compare_advances(const void *a, const void *b)
+{
+    uint32_t x = ((const yui_GlyphAdvance *)a)->codepoint, y = ((const yui_GlyphAdvance *)b)->codepoint;
+    return (x > y) - (x < y);
+}
+
+internal int _compare_kerning(const void *a, const void *b)
+{
+    const yui_KerningPair *x = a, *y = b;
+    if(x->left != y->left) return (x->left > y->left) - (x->left < y->left);
+    return (x->right > y->right) - (x->right < y->right);
+}
+
+void yui_register_font(yui_Ctx *ctx, void *font, const yui_FontMetrics *metrics)
+{
+    yui_FontTable *table = &ctx->fonts;
+    yui_Font *f = _find_font(ctx, font);
+    if(f) {
+        YUI_FREE(f->advances);
+        YUI_FREE(f->kerning);
+        if(metrics == NULL) *f = table->items[--table->count];
+    }
+    if(metrics) {
+        if(f == NULL) {
+            if(table->count == table->cap) {
+                table->cap = table->cap ? table->cap*2 : 4;
+                GROW_ARRAY(table->items, table->cap);
+            }
+            f = &table->items[table->count++];
         }
-    } else {
-        if(x_axis) {
-            box->layout.content_box.w = content_size;
-        } else {
-            box->layout.content_box.h = content_size;
+        *f = (yui_Font){ .font = font, .metrics = *metrics };
+        for(uint32_t i = 0; i < 128; ++i) f->ascii[i] = metrics->default_advance;
+        // ASCII goes into the table, the rest stays sorted for a binary search
+        uint32_t count = 0;
+        if(metrics->count_advances) {
+            f->advances = YUI_MALLOC(metrics->count_advances*sizeof(*f->advances));
+            assert(f->advances != NULL && "Out of memory");
+        }
+        for(uint32_t i = 0; i < metrics->count_advances; ++i) {
+            const yui_GlyphAdvance *a = &metrics->advances[i];
+            if(a->codepoint < 128) f->ascii[a->codepoint] = a->advance;
+            else f->advances[count++] = *a;
         }
+        if(count > 0) qsort(f->advances, count, sizeof(*f->advances), _compare_advances);
+        f->metrics.advances = f->advances;
+        f->metrics.count_advances = count;
+        if(metrics->count_kerning) {
+            f->kerning = YUI_MALLOC(metrics->count_kerning*sizeof(*f->kerning));
+            assert(f->kerning != NULL && "Out of memory");
+            memcpy(f->kerning, metrics->kerning, metrics->count_kerning*sizeof(*f->kerning));
+            qsort(f->kerning, metrics->count_kerning, sizeof(*f->kerning), _compare_kerning);
+        }
+        for(uint32_t i = 0; i < metrics->count_kerning; ++i)
+            if(f->kerning[i].left < 128) f->kerned[f->kerning[i].left >> 3] |= 1u << (f->kerning[i].left & 7);
+        f->metrics.kerning = f->kerning;
     }
-    if(x_axis) {
-        box->layout.filled_width  = content_size;
+    yui_invalidate_text_cache(ctx, font);
+}
+
+int yui_measure_text(yui_Ctx *ctx, void *font, const char *text, int font_size)
+{
+    const yui_Font *f = _find_font(ctx, font);
+    if(f) return _measure_native(f, text, font_size);
+    return HAS_MEASURE_TEXT(ctx) ? MEASURE_TEXT(ctx, font, text, font_size) : 0;
+}
+
+int yui_line_height(yui_Ctx *ctx, void *font, int font_size)
+{
+    return _line_height(ctx, font, font_size);
+}
+
+internal int measure_text(yui_Ctx *ctx, void *font, const char *text, int font_size)
+{
+    const yui_Font *native = _find_font(ctx, font);
+    if(native) {
+        ctx->stats.count_measure_text += 1;
+        return _measure_native(native, text, font_size);
+    }
+    if(!HAS_MEASURE_TEXT(ctx)) return 0;
+    ctx->stats.count_measure_text += 1;
+    yui_TextCache *cache = &ctx->text_cache;
+    if(cache->disabled || text == NULL) return MEASURE_TEXT(ctx, font, text, font_size);
+
+    if(cache->items == NULL) {
+        if(cache->cap == 0) cache->cap = YUI_TEXT_CACHE_CAP;
+        cache->count_buckets = 1;
+        while(cache->count_buckets < cache->cap) cache->count_buckets *= 2;
+        cache->items   = YUI_MALLOC(cache->cap*sizeof(*cache->items));
+        cache->buckets = YUI_MALLOC(cache->count_buckets*sizeof(*cache->buckets));
+        assert(cache->items != NULL && cache->buckets != NULL && "Out of memory");
+        memset(cache->items, 0, cache->cap*sizeof(*cache->items));
+        _text_cache_clear(cache);
+    }
+
+    uint64_t hash = FNV_OFFSET;
+    uint32_t length = 0;
+    for(; text[length]; ++length) {
+        hash ^= (uint8_t)text[length];
+        hash *= FNV_PRIME;
+    }
+    hash = _hash_mix(_hash_mix(hash, (uint64_t)(uintptr_t)font), (uint32_t)font_size);
+
+    uint32_t *bucket = &cache->buckets[hash & (cache->count_buckets - 1)];
+    for(uint32_t index = *bucket; index != TEXT_CACHE_NIL; index = cache->items[index].bucket_next) {
+        yui_TextCacheEntry *entry = &cache->items[index];
+        if(entry->hash == hash && entry->font == font && entry->font_size == font_size && entry->length == length &&
+                memcmp(entry->text, text, length) == 0) {
+            cache->hits += 1;
+            ctx->stats.count_text_cache_hits += 1;
+            if(cache->head != index) {
+                _text_cache_unlink(cache, index);
+                _text_cache_push_front(cache, index);
+            }
+            return entry->width;
+        }
+    }
+
+    cache->misses += 1;
+    int width = MEASURE_TEXT(ctx, font, text, font_size);
+    uint32_t index;
+    if(cache->count < cache->cap) {
+        index = cache->count++;
     } else {
-        box->layout.filled_height = content_size;
+        index = cache->tail;
+        _text_cache_unlink(cache, index);
+        _text_cache_unbucket(cache, index);
     }
+    yui_TextCacheEntry *entry = &cache->items[index];
+    if(entry->cap_text < length + 1) {
+        char *copy = YUI_REALLOC(entry->text, length + 1);
+        assert(copy != NULL && "Out of memory");
+        entry->text = copy;
+        entry->cap_text = length + 1;
+    }
+    memcpy(entry->text, text, length + 1);
+    *entry = (yui_TextCacheEntry){
+        .hash = hash, .font = font, .font_size = font_size, .length = length, .width = width,
+        .bucket_next = *bucket, .text = entry->text, .cap_text = entry->cap_text,
+    };
+    *bucket = index;
+    _text_cache_push_front(cache, index);
+    return width;
 }
 
-internal void _compute_grow_sizing_on(yui_Ctx *ctx, yui_Box *parent, yui_Box *box, bool x_axis)
+internal void _line_cache_rebucket(yui_LineCache *cache)
 {
-    yui_BoxSizing sizing = x_axis ? box->config.sizing.x_axis : box->config.sizing.y_axis;
-    yui_ContentDirection aligned_direction = YUI_CONTENT_LEFT_TO_RIGHT;
-    if(!x_axis) aligned_direction = YUI_CONTENT_TOP_TO_BOTTOM;
-    switch(sizing) {
-    case YUI_BOX_SIZING_FIXED:
-    case YUI_BOX_SIZING_FIT:
-        {
-            if(x_axis) {
-                box->layout.padding_box.w = box->layout.content_box.w + box->config.padding.l + box->config.padding.r;
-                box->layout.margin_box.w = box->layout.padding_box.w + box->config.margin.l + box->config.margin.r;
-            } else {
-                box->layout.padding_box.h = box->layout.content_box.h + box->config.padding.t + box->config.padding.b;
-                box->layout.margin_box.h = box->layout.padding_box.h + box->config.margin.t + box->config.margin.b;
-            }
-        } break;
-    case YUI_BOX_SIZING_GROW:
-        {
-            if(parent) {
-                int pgbc = x_axis 
-                    ? parent->layout.count_children_with_grow_box_on_x_axis
-                    : parent->layout.count_children_with_grow_box_on_y_axis;
-                if(pgbc == 0) pgbc = 0;
-                if(parent->config.content_dir == aligned_direction) {
-                    if(x_axis) {
-                        box->layout.content_box.w += (parent->layout.content_box.w - parent->layout.filled_width)/pgbc;
-                    } else {
-                        box->layout.content_box.h += (parent->layout.content_box.h - parent->layout.filled_height)/pgbc;
-                    }
-                } else {
-                    if(x_axis) {
-                        box->layout.content_box.w  = parent->layout.content_box.w;
-                    } else {
-                        box->layout.content_box.h  =  parent->layout.content_box.h;
-                    }
-                }
-            }
+    for(uint32_t i = 0; i < cache->count_buckets; ++i) cache->buckets[i] = 0;
+    for(uint32_t i = 1; i < cache->count; ++i) {
+        uint32_t *bucket = &cache->buckets[cache->items[i].hash & (cache->count_buckets - 1)];
+        cache->items[i].bucket_next = *bucket;
+        *bucket = i;
+    }
+}
 
-            // TODO: This will make the width of the paddding_box & margin_box bigger than the parent's content_box
-            //       we need to handle padding and margin using the free space not like this
-            if(x_axis) {
-                box->layout.padding_box.w = box->layout.content_box.w + box->config.padding.l + box->config.padding.r;
-                box->layout.margin_box.w = box->layout.padding_box.w + box->config.margin.l + box->config.margin.r;
-            } else {
-                box->layout.padding_box.h = box->layout.content_box.h + box->config.padding.t + box->config.padding.b;
-                box->layout.margin_box.h = box->layout.padding_box.h + box->config.margin.t + box->config.margin.b;
+internal void _line_cache_resize(yui_LineCache *cache, uint32_t cap)
+{
+    GROW_ARRAY(cache->items, cap);
+    memset(cache->items + cache->cap, 0, (size_t)(cap - cache->cap)*sizeof(*cache->items));
+    cache->cap = cap;
+    cache->count_buckets = 1;
+    while(cache->count_buckets < cap) cache->count_buckets *= 2;
+    GROW_ARRAY(cache->buckets, cache->count_buckets);
+    _line_cache_rebucket(cache);
+}
+
+internal void _line_cache_unbucket(yui_LineCache *cache, uint32_t index)
+{
+    uint32_t *link = &cache->buckets[cache->items[index].hash & (cache->count_buckets - 1)];
+    while(*link != index) link = &cache->items[*link].bucket_next;
+    *link = cache->items[index].bucket_next;
+}
+
+internal void _line_cache_link(yui_LineCache *cache, uint32_t index)
+{
+    uint32_t *bucket = &cache->buckets[cache->items[index].hash & (cache->count_buckets - 1)];
+    cache->items[index].bucket_next = *bucket;
+    *bucket = index;
+}
+
+// A free entry, or one nobody has looked up this frame found by a clock sweep. Entries keep
+// their buffers when they are reused. Can move `items`.
+internal uint32_t _line_cache_slot(yui_Ctx *ctx)
+{
+    yui_LineCache *cache = &ctx->line_cache;
+    if(cache->count == cache->cap) {
+        for(uint32_t n = 1; n < cache->count; ++n) {
+            cache->hand = cache->hand + 1 < cache->count ? cache->hand + 1 : 1;
+            if(cache->items[cache->hand].seen_frame != ctx->frame) {
+                _line_cache_unbucket(cache, cache->hand);
+                return cache->hand;
             }
-        } break;
+        }
+        _line_cache_resize(cache, cache->cap*2);
     }
+    return cache->count++;
+}
 
-    for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
-        _compute_grow_sizing_on(ctx, box, child, x_axis);
+// `words` is the start of one block that holds every array of the entry
+internal void _reserve_line_entry(yui_LineCacheEntry *entry, uint32_t count_words, uint32_t length)
+{
+    // There are never more lines than words, word_widths has one more for a space
+    size_t bytes = (size_t)count_words*2*sizeof(uint32_t) + (count_words + 1)*sizeof(int) + 2*(length + 1);
+    if(bytes > entry->cap_bytes) {
+        void *block = YUI_REALLOC(entry->words, bytes);
+        assert(block != NULL && "Out of memory");
+        entry->words = block;
+        entry->cap_bytes = (uint32_t)bytes;
     }
+    entry->word_widths = (int *)(entry->words + count_words);
+    entry->lines = (uint32_t *)(entry->word_widths + count_words + 1);
+    entry->text  = (char *)(entry->lines + count_words);
+    entry->source = entry->text + length + 1;
+    entry->count_words = count_words;
 }
 
-internal void _compute_pos_on(yui_Ctx *ctx, yui_Box *parent, yui_Box *box, bool x_axis) 
+internal inline bool _same_string(const yui_LineCacheEntry *a, const yui_LineCacheEntry *b)
 {
-    if(parent->config.content_dir == YUI_CONTENT_LEFT_TO_RIGHT) {
-        if(x_axis) box->layout.cursor_x = parent->layout.cursor_x;
-        else box->layout.cursor_y = parent->layout.content_box.y;
-    } else {
-        if(x_axis) box->layout.cursor_x = parent->layout.content_box.x;
-        else box->layout.cursor_y = parent->layout.cursor_y;
-    }
+    return a->hash == b->hash && a->font == b->font && a->font_size == b->font_size && a->length == b->length &&
+        memcmp(a->source, b->source, a->length) == 0;
+}
 
-    // Apply margin and padding
-    if(x_axis) {
-        box->layout.margin_box.x = box->layout.cursor_x;
-        box->layout.cursor_x += box->config.margin.l;
-        box->layout.padding_box.x = box->layout.cursor_x;
-        box->layout.cursor_x += box->config.padding.l;
-        box->layout.content_box.x = box->layout.cursor_x;
+// Words are what lies between spaces and newlines, empty ones included
+internal void _measure_words(yui_Ctx *ctx, yui_LineCacheEntry *entry)
+{
+    uint32_t count = entry->count_words;
+    ctx->stats.count_measure_text += count + 1;
+    const yui_Font *native = _find_font(ctx, entry->font);
+    if(native) {
+        for(uint32_t k = 0; k < count; ++k)
+            entry->word_widths[k] = _measure_native(native, entry->text + entry->words[k], entry->font_size);
+        entry->word_widths[count] = _measure_native(native, " ", entry->font_size);
+    } else if(HAS_MEASURE_TEXTS(ctx)) {
+        yui_LineCache *cache = &ctx->line_cache;
+        if(cache->scratch_cap < count + 1) {
+            cache->scratch_cap = count + 1;
+            GROW_ARRAY(cache->scratch, cache->scratch_cap);
+        }
+        for(uint32_t k = 0; k < count; ++k) cache->scratch[k] = entry->text + entry->words[k];
+        cache->scratch[count] = " ";
+        MEASURE_TEXTS(ctx, entry->font, entry->font_size, cache->scratch, count + 1, entry->word_widths);
+    } else if(HAS_MEASURE_TEXT(ctx)) {
+        for(uint32_t k = 0; k < count; ++k)
+            entry->word_widths[k] = MEASURE_TEXT(ctx, entry->font, entry->text + entry->words[k], entry->font_size);
+        entry->word_widths[count] = MEASURE_TEXT(ctx, entry->font, " ", entry->font_size);
     } else {
-        box->layout.margin_box.y = box->layout.cursor_y;
-        box->layout.cursor_y += box->config.margin.t;
-        box->layout.padding_box.y = box->layout.cursor_y;
-        box->layout.cursor_y += box->config.padding.t;
-        box->layout.content_box.y = box->layout.cursor_y;
+        for(uint32_t k = 0; k <= count; ++k) entry->word_widths[k] = 0;
     }
+}
 
-    if(x_axis) {
-        if(box->config.sizing.x_axis == YUI_BOX_SIZING_FIXED) {
-            box->layout.cursor_x += box->layout.content_box.w;
+// Greedy line breaking from the measured words, the space a line is broken at becomes its end
+internal void _break_lines(yui_Ctx *ctx, yui_LineCacheEntry *entry, const char *text, int width)
+{
+    ctx->stats.count_wraps += 1;
+    memcpy(entry->text, text, entry->length + 1);
+    int space = entry->word_widths[entry->count_words];
+    int line = 0;
+    entry->count_lines = 0;
+    for(uint32_t k = 0; k < entry->count_words; ++k) {
+        uint32_t begin = entry->words[k];
+        int word = entry->word_widths[k];
+        if(k == 0 || text[begin - 1] == '\n' || line + space + word > width) {
+            if(k > 0) entry->text[begin - 1] = 0;
+            entry->lines[entry->count_lines++] = begin;
+            line = word;
         } else {
-            for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
-                _compute_pos_on(ctx, box, child, x_axis);
-            }
+            line += space + word;
         }
-        parent->layout.cursor_x += box->layout.margin_box.w;
-    } else {
-        if(box->config.sizing.y_axis == YUI_BOX_SIZING_FIXED) {
-            box->layout.cursor_y += box->layout.content_box.h;
-        } else {
-            for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
-                _compute_pos_on(ctx, box, child, x_axis);
-            }
+    }
+    entry->width = width;
+}
+
+// The entry most recently used for `text`, measured into a new one the first time unless
+// `measured` has the widths of its words and a space
+internal uint32_t _line_entry(yui_Ctx *ctx, const char *text, void *font, int font_size, const int *measured)
+{
+    yui_LineCache *cache = &ctx->line_cache;
+    if(cache->items == NULL) {
+        uint32_t cap = cache->cap ? cache->cap : YUI_LINE_CACHE_CAP;
+        cache->cap = 0;
+        _line_cache_resize(cache, cap);
+        cache->count = 1;
+    }
+
+    uint64_t hash = FNV_OFFSET;
+    uint32_t length = 0;
+    uint32_t count_words = 1;
+    for(; text[length]; ++length) {
+        hash ^= (uint8_t)text[length];
+        hash *= FNV_PRIME;
+        count_words += text[length] == ' ' || text[length] == '\n';
+    }
+    hash = _hash_mix(_hash_mix(hash, (uint64_t)(uintptr_t)font), (uint32_t)font_size);
+
+    uint32_t *bucket = &cache->buckets[hash & (cache->count_buckets - 1)];
+    for(uint32_t *link = bucket; *link; link = &cache->items[*link].bucket_next) {
+        uint32_t index = *link;
+        yui_LineCacheEntry *entry = &cache->items[index];
+        if(entry->hash != hash || entry->font != font || entry->font_size != font_size || entry->length != length ||
+                memcmp(entry->source, text, length) != 0) continue;
+        // Kept at the front so the next box with this string guesses from the latest width
+        *link = entry->bucket_next;
+        entry->bucket_next = *bucket;
+        *bucket = index;
+        entry->seen_frame = ctx->frame;
+        return index;
+    }
+
+    uint32_t index = _line_cache_slot(ctx);
+    yui_LineCacheEntry *entry = &cache->items[index];
+    _reserve_line_entry(entry, count_words, length);
+    entry->hash = hash;
+    entry->font = font;
+    entry->font_size = font_size;
+    entry->length = length;
+    entry->used_frame = 0;
+    entry->seen_frame = ctx->frame;
+    memcpy(entry->text, text, length + 1);
+    memcpy(entry->source, text, length + 1);
+    uint32_t k = 0;
+    entry->words[k++] = 0;
+    for(uint32_t i = 0; i < length; ++i) {
+        if(text[i] != ' ' && text[i] != '\n') continue;
+        entry->text[i] = 0;
+        entry->words[k++] = i + 1;
+    }
+    if(measured) memcpy(entry->word_widths, measured, (count_words + 1)*sizeof(*measured));
+    else _measure_words(ctx, entry);
+
+    int space = entry->word_widths[count_words];
+    int line = 0;
+    entry->natural_width = 0;
+    for(k = 0; k < count_words; ++k) {
+        if(k > 0 && text[entry->words[k] - 1] == '\n') line = 0;
+        else if(k > 0) line += space;
+        line += entry->word_widths[k];
+        entry->natural_width = MY_MAX(entry->natural_width, line);
+    }
+    _break_lines(ctx, entry, text, INT_MAX);
+    _line_cache_link(cache, index);
+    return index;
+}
+
+// An entry with `text` broken into lines at `width`, starting from the entry `index` that
+// yui_text_box found. Without a match one nobody was handed lines from this frame is wrapped
+// again, or a new one copies the measurements.
+internal uint32_t _wrap_lines(yui_Ctx *ctx, uint32_t index, const char *text, int width)
+{
+    yui_LineCache *cache = &ctx->line_cache;
+    if(cache->items[index].width != width) {
+        uint32_t found = 0;
+        uint32_t spare = 0;
+        const yui_LineCacheEntry *base = &cache->items[index];
+        for(uint32_t i = cache->buckets[base->hash & (cache->count_buckets - 1)]; i; i = cache->items[i].bucket_next) {
+            const yui_LineCacheEntry *entry = &cache->items[i];
+            if(!_same_string(entry, base)) continue;
+            if(entry->width == width) { found = i; break; }
+            if(spare == 0 && entry->used_frame != ctx->frame) spare = i;
+        }
+        if(found == 0 && spare == 0) {
+            spare = _line_cache_slot(ctx);
+            base = &cache->items[index];
+            yui_LineCacheEntry *entry = &cache->items[spare];
+            _reserve_line_entry(entry, base->count_words, base->length);
+            entry->hash = base->hash;
+            entry->font = base->font;
+            entry->font_size = base->font_size;
+            entry->length = base->length;
+            entry->natural_width = base->natural_width;
+            memcpy(entry->source, base->source, base->length + 1);
+            memcpy(entry->words, base->words, base->count_words*sizeof(*base->words));
+            memcpy(entry->word_widths, base->word_widths, (base->count_words + 1)*sizeof(*base->word_widths));
+            _line_cache_link(cache, spare);
         }
-        parent->layout.cursor_y += box->layout.margin_box.h;
+        if(found == 0) {
+            _break_lines(ctx, &cache->items[spare], text, width);
+            found = spare;
+        }
+        index = found;
+    }
+    cache->items[index].used_frame = cache->items[index].seen_frame = ctx->frame;
+    return index;
+}
+
+internal void _clear_line_cache(yui_LineCache *cache)
+{
+    if(cache->items == NULL) return;
+    cache->count = 1;
+    cache->hand = 0;
+    for(uint32_t i = 0; i < cache->count_buckets; ++i) cache->buckets[i] = 0;
+}
+
+void yui_invalidate_text_cache(yui_Ctx *ctx, void *font)
+{
+    _clear_line_cache(&ctx->line_cache);
+    yui_TextCache *cache = &ctx->text_cache;
+    if(cache->items == NULL) return;
+    if(font == NULL) {
+        _text_cache_clear(cache);
+        return;
     }
+    // Rebuild from the entries that survive, keeping their LRU order
+    uint32_t order = cache->tail;
+    uint32_t count = cache->count;
+    yui_TextCacheEntry *items = cache->items;
+    cache->items = YUI_MALLOC(cache->cap*sizeof(*cache->items));
+    assert(cache->items != NULL && "Out of memory");
+    memset(cache->items, 0, cache->cap*sizeof(*cache->items));
+    _text_cache_clear(cache);
+    for(uint32_t i = 0; i < count && order != TEXT_CACHE_NIL; ++i, order = items[order].prev) {
+        if(items[order].font == font) continue;
+        uint32_t index = cache->count++;
+        uint32_t *bucket = &cache->buckets[items[order].hash & (cache->count_buckets - 1)];
+        cache->items[index] = items[order];
+        cache->items[index].bucket_next = *bucket;
+        *bucket = index;
+        _text_cache_push_front(cache, index);
+        items[order].text = NULL;
+    }
+    for(uint32_t i = 0; i < cache->cap; ++i) YUI_FREE(items[i].text);
+    YUI_FREE(items);
 }
 
-internal void _render(yui_Ctx *ctx, yui_Box *parent, yui_Box *box)
+internal void _rebuild_retained_slots(yui_RetainedTable *table, uint32_t count_slots)
 {
-    static int v = 0;
-    if(v < ctx->count_boxes + 1) {
-        dumb_box(box, __FUNCTION__);
-        v++;
+    YUI_FREE(table->slots);
+    table->slots = YUI_MALLOC(count_slots*sizeof(*table->slots));
+    assert(table->slots != NULL && "Out of memory");
+    for(uint32_t i = 0; i < count_slots; ++i) table->slots[i] = 0;
+    table->count_slots = count_slots;
+    for(uint32_t i = 1; i < table->count; ++i) {
+        uint32_t slot = (uint32_t)table->items[i].key & (count_slots - 1);
+        while(table->slots[slot]) slot = (slot + 1) & (count_slots - 1);
+        table->slots[slot] = i;
     }
-    if(box->text) {
-        draw_text(ctx, box->config.text.font, box->text, box->config.text.font_size, 
-                box->layout.content_box.x, box->layout.content_box.y, box->config.text.color);
-    } else {
-        draw_rect(ctx, box->layout.padding_box, box->config.background_color, 0);
-        for(yui_Box *child = box->children.begin; child != NULL; child = child->next)
-            _render(ctx, box, child);
+}
+
+internal uint32_t _get_retained(yui_RetainedTable *table, uint64_t key)
+{
+    if(table->count_slots == 0 || table->count*2 >= table->count_slots)
+        _rebuild_retained_slots(table, table->count_slots ? table->count_slots*2 : 256);
+
+    uint32_t slot = (uint32_t)key & (table->count_slots - 1);
+    while(table->slots[slot]) {
+        uint32_t index = table->slots[slot];
+        if(table->items[index].key == key) return index;
+        slot = (slot + 1) & (table->count_slots - 1);
     }
+
+    if(table->count == 0) table->count = 1;
+    if(table->count >= table->cap) {
+        uint32_t cap = table->cap ? table->cap*2 : 256;
+        yui_Retained *items = YUI_REALLOC(table->items, cap*sizeof(*items));
+        assert(items != NULL && "Out of memory");
+        table->items = items;
+        table->cap = cap;
+    }
+    uint32_t index = table->count++;
+    table->items[index] = (yui_Retained){ .key = key, .seen_frame = UINT32_MAX };
+    table->slots[slot] = index;
+    return index;
 }
 
-void yui_end_frame(yui_Ctx *ctx)
+// Drop entries that were not seen last frame, they can never be reused
+internal void _compact_retained(yui_RetainedTable *table, uint32_t last_frame)
 {
-    yui_Box *root = &ctx->root;
-    _compute_fit_sizing_on(ctx, NULL, root, true);
-    _compute_fit_sizing_on(ctx, NULL, root, false);
-    _compute_grow_sizing_on(ctx, NULL, root, true);
-    _compute_grow_sizing_on(ctx, NULL, root, false);
-    for(yui_Box *child = ctx->root.children.begin; child != NULL; child = child->next) {
-        _compute_pos_on(ctx, root, child, true);
-        _compute_pos_on(ctx, root, child, false);
-    }
-    _render(ctx, NULL, root);
+    uint32_t count_stale = table->count > 1 ? table->count - 1 - table->live : 0;
+    if(count_stale <= table->live + 256) return;
+    uint32_t count = 1;
+    for(uint32_t i = 1; i < table->count; ++i) {
+        if(table->items[i].seen_frame == last_frame)
+            table->items[count++] = table->items[i];
+    }
+    table->count = count;
+    _rebuild_retained_slots(table, table->count_slots);
+}
+
+internal inline int _clamp_scroll(int offset, int filled, int size)
+{
+    return MY_MAX(MY_MIN(offset, filled - size), 0);
+}
+
+// Keeps the clamped offset and the size of the view for the next frame
+internal void _save_scroll(yui_Ctx *ctx, yui_Box *box)
+{
+    if(box->retained == 0) return;
+    yui_Retained *entry = &ctx->retained.items[box->retained];
+    entry->scroll = box->scroll;
+    yui_Rect content = yui_content_box(box);
+    entry->view = (yui_Point){ content.w, content.h };
+}
+
+internal inline bool _box_scrolls(const yui_Box *box)
+{
+    return box->style->config.overflow.x_axis == YUI_OVERFLOW_SCROLL || box->style->config.overflow.y_axis == YUI_OVERFLOW_SCROLL;
+}
+
+internal void _reserve_flat(yui_FlatLayout *flat, uint32_t count)
+{
+    if(count <= flat->cap) return;
+    uint32_t cap = flat->cap ? flat->cap : 256;
+    while(cap < count) cap *= 2;
+    GROW_ARRAY(flat->parent, cap);
+    GROW_ARRAY(flat->subtree_end, cap);
+    GROW_ARRAY(flat->content_dir, cap);
+    GROW_ARRAY(flat->boxes, cap);
+    for(int a = 0; a < 2; ++a) {
+        yui_FlatAxis *axis = &flat->axis[a];
+        GROW_ARRAY(axis->sizing, cap);
+        GROW_ARRAY(axis->fixed, cap);
+        GROW_ARRAY(axis->lead, cap);
+        GROW_ARRAY(axis->lead_margin, cap);
+        GROW_ARRAY(axis->padding, cap);
+        GROW_ARRAY(axis->margin, cap);
+        GROW_ARRAY(axis->content_size, cap);
+        GROW_ARRAY(axis->filled, cap);
+        GROW_ARRAY(axis->count_grow, cap);
+        GROW_ARRAY(axis->padding_size, cap);
+        GROW_ARRAY(axis->margin_size, cap);
+        GROW_ARRAY(axis->content_pos, cap);
+        GROW_ARRAY(axis->padding_pos, cap);
+        GROW_ARRAY(axis->cursor, cap);
+        GROW_ARRAY(axis->overflow, cap);
+        GROW_ARRAY(axis->scroll, cap);
+    }
+    flat->cap = cap;
+}
+
+internal void _free_flat(yui_FlatLayout *flat)
+{
+    YUI_FREE(flat->parent);
+    YUI_FREE(flat->subtree_end);
+    YUI_FREE(flat->content_dir);
+    YUI_FREE(flat->boxes);
+    for(int a = 0; a < 2; ++a) {
+        yui_FlatAxis *axis = &flat->axis[a];
+        YUI_FREE(axis->sizing);
+        YUI_FREE(axis->fixed);
+        YUI_FREE(axis->lead);
+        YUI_FREE(axis->lead_margin);
+        YUI_FREE(axis->padding);
+        YUI_FREE(axis->margin);
+        YUI_FREE(axis->content_size);
+        YUI_FREE(axis->filled);
+        YUI_FREE(axis->count_grow);
+        YUI_FREE(axis->padding_size);
+        YUI_FREE(axis->margin_size);
+        YUI_FREE(axis->content_pos);
+        YUI_FREE(axis->padding_pos);
+        YUI_FREE(axis->cursor);
+        YUI_FREE(axis->overflow);
+        YUI_FREE(axis->scroll);
+    }
+    *flat = (yui_FlatLayout){0};
+}
+
+internal void _push_flat(yui_FlatLayout *flat, yui_Box *box, uint32_t parent)
+{
+    uint32_t i = flat->count++;
+    assert(i == box->id && "Flat layout expects boxes in allocation order");
+    _reserve_flat(flat, flat->count);
+    flat->parent[i] = parent;
+    flat->subtree_end[i] = i + 1;
+    const yui_Style *style = box->style;
+    flat->content_dir[i] = (uint8_t)style->config.content_dir;
+    flat->boxes[i] = box;
+    yui_FlatAxis *x = &flat->axis[0];
+    x->sizing[i] = (uint8_t)style->config.sizing.x_axis;
+    x->fixed[i] = box->fixed_width;
+    x->lead_margin[i] = style->lead_margin[0];
+    x->lead[i] = style->lead[0];
+    x->padding[i] = style->padding[0];
+    x->margin[i] = style->margin[0];
+    x->overflow[i] = (uint8_t)style->config.overflow.x_axis;
+    yui_FlatAxis *y = &flat->axis[1];
+    y->sizing[i] = (uint8_t)style->config.sizing.y_axis;
+    y->fixed[i] = box->fixed_height;
+    y->lead_margin[i] = style->lead_margin[1];
+    y->lead[i] = style->lead[1];
+    y->padding[i] = style->padding[1];
+    y->margin[i] = style->margin[1];
+    y->overflow[i] = (uint8_t)style->config.overflow.y_axis;
+}
+
+// Together with _compute_flat_grow_and_pos mirrors _compute_fit_sizing, _compute_grow_sizing_on
+// and _compute_pos_on exactly, including children of a FIXED box not being positioned on that axis
+// unless it scrolls.
+internal void _compute_flat_fit(yui_Ctx *ctx)
+{
+    yui_FlatLayout *flat = &ctx->flat;
+    uint32_t count = flat->count;
+    const uint32_t *parent = flat->parent;
+    const uint8_t *content_dir = flat->content_dir;
+
+    for(int a = 0; a < 2; ++a) {
+        yui_FlatAxis *axis = &flat->axis[a];
+        for(uint32_t i = 0; i < count; ++i) {
+            axis->filled[i] = 0;
+            axis->count_grow[i] = 0;
+        }
+    }
+    if(ctx->count_wrapped) {
+        for(uint32_t i = 0; i < count; ++i)
+            if(flat->boxes[i]->lines) flat->axis[0].filled[i] = flat->axis[0].fixed[i];
+    }
+
+    // Children come after their parent so a backward sweep sees them first
+    for(int a = 0; a < 2; ++a) {
+        yui_FlatAxis *axis = &flat->axis[a];
+        uint8_t aligned = a == 0 ? YUI_CONTENT_LEFT_TO_RIGHT : YUI_CONTENT_TOP_TO_BOTTOM;
+        const uint8_t *sizing = axis->sizing;
+        int *filled = axis->filled;
+        int *content_size = axis->content_size;
+        uint32_t *count_grow = axis->count_grow;
+        for(uint32_t i = count; i-- > 1;) {
+            if(sizing[i] == YUI_BOX_SIZING_FIXED) content_size[i] = axis->fixed[i];
+            else if(sizing[i] == YUI_BOX_SIZING_GROW && axis->overflow[i] == YUI_OVERFLOW_SCROLL) content_size[i] = 0;
+            else content_size[i] = filled[i];
+            uint32_t p = parent[i];
+            int size = content_size[i] + axis->padding[i] + axis->margin[i];
+            if(content_dir[p] == aligned) filled[p] += size;
+            else filled[p] = MY_MAX(filled[p], size);
+            count_grow[p] += sizing[i] == YUI_BOX_SIZING_GROW;
+        }
+        content_size[0] = sizing[0] == YUI_BOX_SIZING_FIXED ? axis->fixed[0] : filled[0];
+    }
+}
+
+// Grow sizing and positioning, parents come before their children
+internal void _compute_flat_grow_and_pos(yui_Ctx *ctx)
+{
+    yui_FlatLayout *flat = &ctx->flat;
+    uint32_t count = flat->count;
+    const uint32_t *parent = flat->parent;
+    const uint8_t *content_dir = flat->content_dir;
+
+    for(int a = 0; a < 2; ++a) {
+        yui_FlatAxis *axis = &flat->axis[a];
+        uint8_t aligned = a == 0 ? YUI_CONTENT_LEFT_TO_RIGHT : YUI_CONTENT_TOP_TO_BOTTOM;
+        const uint8_t *sizing = axis->sizing;
+        int *content_size = axis->content_size;
+        int *margin_size = axis->margin_size;
+        int *content_pos = axis->content_pos;
+        int *scroll = axis->scroll;
+        uint32_t *cursor = axis->cursor;
+        axis->padding_size[0] = content_size[0] + axis->padding[0];
+        margin_size[0] = axis->padding_size[0] + axis->margin[0];
+        content_pos[0] = axis->padding_pos[0] = 0;
+        scroll[0] = 0;
+        cursor[0] = 0;
+        uint32_t skip_until = 0;
+        for(uint32_t i = 1; i < count; ++i) {
+            uint32_t p = parent[i];
+            if(sizing[i] == YUI_BOX_SIZING_GROW) {
+                if(content_dir[p] == aligned) content_size[i] += (content_size[p] - axis->filled[p])/(int)axis->count_grow[p];
+                else content_size[i] = content_size[p];
+            }
+            axis->padding_size[i] = content_size[i] + axis->padding[i];
+            margin_size[i] = axis->padding_size[i] + axis->margin[i];
+            bool scrolls = axis->overflow[i] == YUI_OVERFLOW_SCROLL;
+            scroll[i] = 0;
+            if(scrolls) {
+                const yui_Point *offset = &flat->boxes[i]->scroll;
+                scroll[i] = _clamp_scroll(a == 0 ? offset->x : offset->y, axis->filled[i], content_size[i]);
+            }
+
+            if(i < skip_until) {
+                content_pos[i] = axis->padding_pos[i] = 0;
+                cursor[i] = 0;
+                continue;
+            }
+            uint32_t at = content_dir[p] == aligned ? cursor[p] : (uint32_t)(content_pos[p] - scroll[p]);
+            axis->padding_pos[i] = (int)(at + axis->lead_margin[i]);
+            at += axis->lead[i];
+            content_pos[i] = (int)at;
+            if(scrolls) {
+                at -= scroll[i];
+            } else if(sizing[i] == YUI_BOX_SIZING_FIXED) {
+                at += content_size[i];
+                skip_until = flat->subtree_end[i];
+            }
+            cursor[i] = at;
+            cursor[p] += margin_size[i];
+        }
+    }
+
+    const yui_FlatAxis *x = &flat->axis[0];
+    const yui_FlatAxis *y = &flat->axis[1];
+    for(uint32_t i = 0; i < count; ++i) {
+        flat->boxes[i]->layout.padding_box = (yui_Rect){ x->padding_pos[i], y->padding_pos[i], x->padding_size[i], y->padding_size[i] };
+        if(x->overflow[i] == YUI_OVERFLOW_SCROLL || y->overflow[i] == YUI_OVERFLOW_SCROLL) {
+            flat->boxes[i]->scroll = (yui_Point){ x->scroll[i], y->scroll[i] };
+            _save_scroll(ctx, flat->boxes[i]);
+        }
+    }
+}
+
+void yui_destroy(yui_Ctx *ctx)
+{
+    yui_HitIndex *index = &ctx->hit_index;
+    YUI_FREE(index->boxes);
+    YUI_FREE(index->rects);
+    YUI_FREE(index->stamps);
+    YUI_FREE(index->cell_begin);
+    YUI_FREE(index->cell_items);
+    YUI_FREE(index->large);
+    *index = (yui_HitIndex){ .enabled = index->enabled, .cell_size = index->cell_size };
+    _free_style_table(&ctx->styles);
+    _free_style_table(&ctx->frame_styles);
+    for(uint32_t i = 0; i < ctx->fonts.count; ++i) {
+        YUI_FREE(ctx->fonts.items[i].advances);
+        YUI_FREE(ctx->fonts.items[i].kerning);
+    }
+    YUI_FREE(ctx->fonts.items);
+    ctx->fonts = (yui_FontTable){0};
+    yui_Changes *changes = &ctx->changes;
+    YUI_FREE(changes->items);
+    YUI_FREE(changes->nodes);
+    YUI_FREE(changes->prev);
+    YUI_FREE(changes->slots);
+    YUI_FREE(changes->prev_slots);
+    *changes = (yui_Changes){ .enabled = changes->enabled };
+    YUI_FREE(ctx->input.hovered);
+    YUI_FREE(ctx->input.active);
+    ctx->input = (yui_Input){0};
+    _free_flat(&ctx->flat);
+    for(uint32_t i = 0; ctx->text_cache.items && i < ctx->text_cache.cap; ++i) YUI_FREE(ctx->text_cache.items[i].text);
+    YUI_FREE(ctx->text_cache.items);
+    YUI_FREE(ctx->text_cache.buckets);
+    ctx->text_cache.items = NULL;
+    ctx->text_cache.buckets = NULL;
+    ctx->text_cache.count = 0;
+    yui_LineCache *lines = &ctx->line_cache;
+    for(uint32_t i = 0; lines->items && i < lines->cap; ++i) YUI_FREE(lines->items[i].words);
+    YUI_FREE(lines->items);
+    YUI_FREE(lines->buckets);
+    YUI_FREE(lines->scratch);
+    *lines = (yui_LineCache){ .cap = lines->cap };
+    YUI_FREE(ctx->parallel.items);
+    YUI_FREE(ctx->parallel.tasks);
+    ctx->parallel = (yui_Parallel){0};
+    YUI_FREE(ctx->wrap_guesses);
+    ctx->wrap_guesses = NULL;
+    ctx->count_wrap_guesses = ctx->cap_wrap_guesses = 0;
+    YUI_FREE(ctx->damage.records[0]);
+    YUI_FREE(ctx->damage.records[1]);
+    YUI_FREE(ctx->damage.slots);
+    ctx->damage.records[0] = ctx->damage.records[1] = NULL;
+    ctx->damage.cap_records[0] = ctx->damage.cap_records[1] = 0;
+    ctx->damage.count_records[0] = ctx->damage.count_records[1] = 0;
+    ctx->damage.slots = NULL;
+    ctx->damage.count_slots = 0;
+    ctx->damage.count_frames = 0;
+    YUI_FREE(ctx->draw_list.scratch);
+    YUI_FREE(ctx->draw_list.keys);
+    ctx->draw_list.scratch = NULL;
+    ctx->draw_list.keys = NULL;
+    ctx->draw_list.scratch_cap = 0;
+    YUI_FREE(ctx->retained.items);
+    YUI_FREE(ctx->retained.slots);
+    ctx->retained = (yui_RetainedTable){0};
+    YUI_FREE(ctx->kept.prev);
+    YUI_FREE(ctx->kept.curr);
+    ctx->kept = (yui_KeptLayouts){0};
+
+    yui_BoxChunk *chunk = ctx->boxes.first;
+    while(chunk) {
+        yui_BoxChunk *next = chunk->next;
+        if(chunk->owned) YUI_FREE(chunk);
+        chunk = next;
+    }
+    ctx->boxes = (yui_BoxArena){ .chunk_cap = ctx->boxes.chunk_cap };
+
+    yui_StringChunk *strings = ctx->strings.first;
+    while(strings) {
+        yui_StringChunk *next = strings->next;
+        YUI_FREE(strings);
+        strings = next;
+    }
+    ctx->strings = (yui_StringArena){ .chunk_cap = ctx->strings.chunk_cap };
+}
+
+#define YUI_SORT_WINDOW 64
+#define YUI_SORT_FONTS_CAP 32
+
+#define POINT_IN_RECT(R, X, Y) (((R).x <= (X) && (X) < (R).x + (R).w) && ((R).y <= (Y) && (Y) < (R).y + (R).h))
+
+yui_Box *yui_hit_test(yui_Box *box, int x, int y)
+{
+    if(POINT_IN_RECT(box->layout.padding_box, x, y)) {
+        for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
+            yui_Box *result = yui_hit_test(child, x, y);
+            if(result != NULL)
+                return result;
+        }
+        return box;
+    }
+    return NULL;
+}
+
+internal inline uint64_t _box_identity(const yui_Box *box)
+{
+    return box->key != 0 ? box->key : box->id;
+}
+
+// The key yui_open_box_keyed gives a box opened in the current box
+internal uint64_t _child_key(yui_Ctx *ctx, const char *key, uint32_t index)
+{
+    uint64_t h = _hash_mix(_hash_str(FNV_OFFSET, key), index);
+    h = _hash_mix(h, ctx->curr->key);
+    return h != 0 ? h : 1;
+}
+
+internal bool _has_identity(const uint64_t *items, uint32_t count, uint64_t identity)
+{
+    for(uint32_t i = 0; i < count; ++i)
+        if(items[i] == identity) return true;
+    return false;
+}
+
+// Runs before the boxes are rewound, while they still hold the layout of the frame that ended
+internal void _resolve_input(yui_Ctx *ctx)
+{
+    yui_Input *input = &ctx->input;
+    input->count_hovered = 0;
+    if(input->released) input->count_active = 0;
+    input->pressed  = input->down && !input->was_down;
+    input->released = !input->down && input->was_down;
+    input->was_down = input->down;
+    if(ctx->frame > 0 && ctx->ended_frame == ctx->frame) {
+        yui_Box *hit = yui_hit_test_top(ctx, input->pointer.x, input->pointer.y);
+        for(yui_Box *box = hit; box != NULL && box != &ctx->root; box = box->parent) {
+            if(input->count_hovered == input->cap_hovered) {
+                input->cap_hovered = input->cap_hovered ? 2*input->cap_hovered : 16;
+                GROW_ARRAY(input->hovered, input->cap_hovered);
+            }
+            input->hovered[input->count_hovered++] = _box_identity(box);
+        }
+    }
+    if(input->pressed) {
+        if(input->cap_active < input->count_hovered) {
+            input->cap_active = input->cap_hovered;
+            GROW_ARRAY(input->active, input->cap_active);
+        }
+        for(uint32_t i = 0; i < input->count_hovered; ++i) input->active[i] = input->hovered[i];
+        input->count_active = input->count_hovered;
+    }
+}
+
+internal yui_Interaction _get_interaction(yui_Ctx *ctx, uint64_t identity)
+{
+    yui_Input *input = &ctx->input;
+    yui_Interaction result = {0};
+    result.hovered = _has_identity(input->hovered, input->count_hovered, identity);
+    bool active = _has_identity(input->active, input->count_active, identity);
+    result.active  = active && !input->released;
+    result.pressed = active && input->pressed;
+    result.clicked = active && input->released && result.hovered;
+    return result;
+}
+
+void yui_set_pointer(yui_Ctx *ctx, int x, int y, bool down)
+{
+    ctx->input.enabled = true;
+    ctx->input.pointer = (yui_Point){ x, y };
+    ctx->input.down = down;
+}
+
+yui_Interaction yui_get_interaction(yui_Ctx *ctx, const yui_Box *box)
+{
+    return _get_interaction(ctx, _box_identity(box));
+}
+
+yui_Interaction yui_get_interaction_keyed(yui_Ctx *ctx, const char *key, uint32_t index)
+{
+    return _get_interaction(ctx, _child_key(ctx, key, index));
+}
+
+bool yui_is_hovered(yui_Ctx *ctx, const yui_Box *box)
+{
+    return _has_identity(ctx->input.hovered, ctx->input.count_hovered, _box_identity(box));
+}
+
+void yui_begin_frame(yui_Ctx *ctx, uint32_t root_width, uint32_t root_height)
+{
+    if(ctx->input.enabled) _resolve_input(ctx);
+    _rewind_boxes(&ctx->boxes);
+    _clear_style_table(&ctx->frame_styles);
+    _compact_retained(&ctx->retained, ctx->frame);
+    ctx->retained.live = 0;
+    ctx->frame += 1;
+    ctx->stats = (yui_FrameStats){0};
+    ctx->count_wrapped = 0;
+    ctx->scroll_hash = 0;
+    ctx->text_pointers = 0;
+    ctx->strings.curr = ctx->strings.first;
+    ctx->strings.used = 0;
+    yui_Box *root = &ctx->root;
+    _reset_box(root);
+    // Boxes take the slots of last frame's boxes in the same order, so an unchanged frame
+    // finds its layout in place. yui_end_frame clears it when the frame changed.
+    if(!ctx->skip_unchanged) root->layout = (yui_BoxLayout){0};
+    root->style = &root_style;
+    root->fixed_width  = root_width;
+    root->fixed_height = root_height;
+    root->id = 0;
+    ctx->curr = root;
+    ctx->flat.active = ctx->flat_layout;
+    ctx->flat.count = 0;
+    if(ctx->flat.active) _push_flat(&ctx->flat, root, 0);
+}
+
+internal yui_Box *_open_box(yui_Ctx *ctx, uint64_t key, const yui_Style *style, int fixed_width, int fixed_height)
+{
+    ctx->level += 1;
+    yui_Box *prev = ctx->curr;
+    yui_Box *curr = _alloc_box(&ctx->boxes);
+    uint32_t id = ctx->boxes.count;
+    _reset_box(curr);
+    if(!ctx->skip_unchanged) curr->layout = (yui_BoxLayout){0};
+    curr->id = id;
+    curr->level = ctx->level;
+    ctx->stats.max_depth = MY_MAX(ctx->stats.max_depth, ctx->level);
+    curr->style = style;
+    curr->fixed_width  = fixed_width;
+    curr->fixed_height = fixed_height;
+    curr->hash = style->hash;
+    // Text boxes and spacers size themselves
+    if(fixed_width != style->config.fixed_width || fixed_height != style->config.fixed_height)
+        curr->hash = _hash_mix(curr->hash, (uint32_t)fixed_width | (uint64_t)(uint32_t)fixed_height << 32);
+    if(key == 0 && prev->key != 0) {
+        curr->key = _hash_mix(prev->key, prev->children.count + 1);
+    } else if(key != 0) {
+        uint32_t index = _get_retained(&ctx->retained, key);
+        yui_Retained *entry = &ctx->retained.items[index];
+        // The same key twice in one frame, the second box is treated as unkeyed
+        if(entry->seen_frame != ctx->frame) {
+            curr->key = key;
+            curr->retained = index;
+            curr->clean = entry->seen_frame + 1 == ctx->frame && ctx->retained_frame + 1 == ctx->frame;
+            if(style->config.overflow.x_axis == YUI_OVERFLOW_SCROLL) curr->scroll.x = entry->scroll.x;
+            if(style->config.overflow.y_axis == YUI_OVERFLOW_SCROLL) curr->scroll.y = entry->scroll.y;
+            entry->seen_frame = ctx->frame;
+            entry->prev_id = entry->id;
+            entry->id = id;
+            ctx->retained.live += 1;
+            // Keys pick the scroll offsets and what is retained
+            curr->hash = _hash_mix(curr->hash, key);
+        }
+    }
+    _add_box_child(prev, curr);
+    if(ctx->flat.active) _push_flat(&ctx->flat, curr, prev->id);
+    ctx->curr = curr;
+    return curr;
+}
+
+internal inline yui_Box *_open_styled(yui_Ctx *ctx, uint64_t key, const yui_Style *style)
+{
+    return _open_box(ctx, key, style, style->config.fixed_width, style->config.fixed_height);
+}
+
+internal inline const yui_Style *_get_style(yui_Ctx *ctx, yui_StyleId style)
+{
+    assert(style > 0 && style < ctx->styles.count && "Not a style of this context");
+    return ctx->styles.items[style];
+}
+
+yui_Box *yui_open_box(yui_Ctx *ctx, yui_BoxConfig config)
+{
+    return _open_styled(ctx, 0, _frame_style(ctx, &config));
+}
+
+yui_Box *yui_open_box_keyed(yui_Ctx *ctx, const char *key, uint32_t index, yui_BoxConfig config)
+{
+    return _open_styled(ctx, _child_key(ctx, key, index), _frame_style(ctx, &config));
+}
+
+yui_Box *yui_open_box_style(yui_Ctx *ctx, yui_StyleId style)
+{
+    return _open_styled(ctx, 0, _get_style(ctx, style));
+}
+
+yui_Box *yui_open_box_keyed_style(yui_Ctx *ctx, const char *key, uint32_t index, yui_StyleId style)
+{
+    return _open_styled(ctx, _child_key(ctx, key, index), _get_style(ctx, style));
+}
+
+void yui_close_box(yui_Ctx *ctx)
+{
+    yui_Box *box = ctx->curr;
+    box->hash = _hash_str(box->hash, box->text);
+    if(box->retained) {
+        yui_Retained *entry = &ctx->retained.items[box->retained];
+        box->clean = box->clean && entry->hash == box->hash;
+        entry->hash = box->hash;
+    }
+    box->count_subtree = ctx->boxes.count - box->id + 1;
+    if(ctx->flat.active) ctx->flat.subtree_end[box->id] = ctx->flat.count;
+    yui_Box *parent = box->parent;
+    parent->hash = _hash_mix(parent->hash, box->hash);
+    ctx->level -= 1;
+    ctx->curr = parent;
+}
+
+// `measured` replaces the measure callbacks when it is set, see yui_SnapshotBox.widths
+internal void _text_box(yui_Ctx *ctx, const char *text, yui_TextConfig text_config, const int *measured)
+{
+    yui_BoxConfig config = {0};
+    config.text = text_config;
+    config.sizing.x_axis = YUI_BOX_SIZING_FIXED;
+    config.sizing.y_axis = YUI_BOX_SIZING_FIXED;
+    int font_size = config.text.font_size;
+    int height = _line_height(ctx, config.text.font, font_size);
+    int width;
+    uint32_t lines = 0;
+    if(config.text.wrap && text != NULL) {
+        // Grows from its widest line. The height is a guess that layout corrects, from last
+        // frame or else from the last width the string was wrapped at
+        lines = _line_entry(ctx, text, config.text.font, font_size, measured);
+        const yui_LineCacheEntry *entry = &ctx->line_cache.items[lines];
+        config.sizing.x_axis = YUI_BOX_SIZING_GROW;
+        width = entry->natural_width;
+        uint32_t n = ctx->count_wrapped++;
+        if(n < ctx->count_wrap_guesses && ctx->wrap_guesses[n].hash == entry->hash) {
+            height = ctx->wrap_guesses[n].height;
+        } else {
+            height *= (int)entry->count_lines;
+        }
+        if(n == ctx->cap_wrap_guesses) {
+            ctx->cap_wrap_guesses = ctx->cap_wrap_guesses ? ctx->cap_wrap_guesses*2 : 64;
+            GROW_ARRAY(ctx->wrap_guesses, ctx->cap_wrap_guesses);
+        }
+        ctx->wrap_guesses[n].hash = entry->hash;
+    } else {
+        width = measured ? measured[0] : measure_text(ctx, config.text.font, text, font_size);
+    }
+    _open_box(ctx, 0, _frame_style(ctx, &config), width, height);
+    ctx->curr->text = text;
+    ctx->curr->lines = lines;
+    ctx->text_pointers = _hash_mix(ctx->text_pointers, (uint64_t)(uintptr_t)text);
+    if(lines) ctx->wrap_guesses[ctx->count_wrapped - 1].box = ctx->curr;
+    yui_close_box(ctx);
+}
+
+void yui_text_box(yui_Ctx *ctx, const char *text, yui_TextConfig text_config)
+{
+    _text_box(ctx, text, text_config, NULL);
+}
+
+yui_Rect yui_content_box(const yui_Box *box)
+{
+    const yui_Style *style = box->style;
+    yui_Rect r = box->layout.padding_box;
+    return (yui_Rect){ r.x + style->config.padding.l, r.y + style->config.padding.t,
+                       r.w - style->padding[0], r.h - style->padding[1] };
+}
+
+yui_Rect yui_margin_box(const yui_Box *box)
+{
+    const yui_Style *style = box->style;
+    yui_Rect r = box->layout.padding_box;
+    return (yui_Rect){ r.x - style->config.margin.l, r.y - style->config.margin.t,
+                       r.w + style->margin[0], r.h + style->margin[1] };
+}
+
+// Moves on to the next chunk that holds `size` bytes, a smaller one is kept for later frames
+internal char *_next_string_chunk(yui_StringArena *arena, uint32_t size)
+{
+    yui_StringChunk *next = arena->curr ? arena->curr->next : arena->first;
+    if(next == NULL || next->cap < size) {
+        uint32_t cap = MY_MAX(arena->chunk_cap ? arena->chunk_cap : YUI_STRING_CHUNK_CAP, size);
+        yui_StringChunk *chunk = YUI_MALLOC(sizeof(*chunk) + cap);
+        assert(chunk != NULL && "Out of memory");
+        chunk->cap = cap;
+        chunk->next = next;
+        if(arena->curr) arena->curr->next = chunk;
+        else arena->first = chunk;
+        next = chunk;
+    }
+    arena->curr = next;
+    arena->used = 0;
+    return next->data;
+}
+
+const char *yui_frame_vprintf(yui_Ctx *ctx, const char *fmt, va_list args)
+{
+    yui_StringArena *arena = &ctx->strings;
+    // Straight into the rest of the chunk, only formatted again when it did not fit
+    char *dst = arena->curr ? arena->curr->data + arena->used : NULL;
+    size_t left = arena->curr ? arena->curr->cap - arena->used : 0;
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(dst, left, fmt, copy);
+    va_end(copy);
+    if(length < 0) return "";
+    if((size_t)length >= left) {
+        dst = _next_string_chunk(arena, (uint32_t)length + 1);
+        vsnprintf(dst, (size_t)length + 1, fmt, args);
+    }
+    arena->used += (uint32_t)length + 1;
+    return dst;
+}
+
+const char *yui_frame_printf(yui_Ctx *ctx, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    const char *str = yui_frame_vprintf(ctx, fmt, args);
+    va_end(args);
+    return str;
+}
+
+void yui_text_boxf(yui_Ctx *ctx, yui_TextConfig text_config, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    const char *text = yui_frame_vprintf(ctx, fmt, args);
+    va_end(args);
+    _text_box(ctx, text, text_config, NULL);
+}
+
+yui_Point yui_get_scroll(yui_Ctx *ctx, const yui_Box *box)
+{
+    (void)ctx;
+    return box->scroll;
+}
+
+void yui_set_scroll(yui_Ctx *ctx, yui_Box *box, yui_Point offset)
+{
+    box->scroll.x = box->style->config.overflow.x_axis == YUI_OVERFLOW_SCROLL ? MY_MAX(offset.x, 0) : 0;
+    box->scroll.y = box->style->config.overflow.y_axis == YUI_OVERFLOW_SCROLL ? MY_MAX(offset.y, 0) : 0;
+    if(box->retained) ctx->retained.items[box->retained].scroll = box->scroll;
+    // Hashes leave scroll offsets out, the keyed boxes around this one can't be moved as they were
+    for(yui_Box *b = box; b != NULL; b = b->parent) b->clean = false;
+    ctx->scroll_hash = _hash_mix(_hash_mix(ctx->scroll_hash, box->id), (uint32_t)box->scroll.x | (uint64_t)(uint32_t)box->scroll.y << 32);
+}
+
+void yui_scroll_by(yui_Ctx *ctx, yui_Box *box, int dx, int dy)
+{
+    yui_set_scroll(ctx, box, (yui_Point){ box->scroll.x + dx, box->scroll.y + dy });
+}
+
+// A FIXED box of `extent` along the parent's content direction
+internal void _open_spacer(yui_Ctx *ctx, bool x_axis, int extent)
+{
+    yui_BoxConfig config = {0};
+    config.sizing.x_axis = YUI_BOX_SIZING_FIXED;
+    config.sizing.y_axis = YUI_BOX_SIZING_FIXED;
+    _open_box(ctx, 0, _frame_style(ctx, &config), x_axis ? extent : 0, x_axis ? 0 : extent);
+    yui_close_box(ctx);
+}
+
+internal inline int _list_extent(uint32_t count, int item_extent)
+{
+    int64_t extent = (int64_t)count*item_extent;
+    return extent > INT32_MAX ? INT32_MAX : (int)extent;
+}
+
+yui_VirtualList yui_begin_virtual_list(yui_Ctx *ctx, uint32_t count_items, int item_extent)
+{
+    yui_Box *box = ctx->curr;
+    bool x_axis = box->style->config.content_dir == YUI_CONTENT_LEFT_TO_RIGHT;
+    yui_VirtualList list = { .count = count_items, .item_extent = MY_MAX(item_extent, 1) };
+
+    // Before layout the size of the view is only known from last frame, the first frame
+    // falls back to the fixed size or the size of the screen
+    int view = 0;
+    if(box->retained) {
+        yui_Point last = ctx->retained.items[box->retained].view;
+        view = x_axis ? last.x : last.y;
+    }
+    if(view <= 0) {
+        yui_BoxSizing sizing = x_axis ? box->style->config.sizing.x_axis : box->style->config.sizing.y_axis;
+        if(sizing == YUI_BOX_SIZING_FIXED) view = x_axis ? box->fixed_width : box->fixed_height;
+        else view = x_axis ? ctx->root.fixed_width : ctx->root.fixed_height;
+    }
+
+    // Clamped here as well so a list that got shorter does not come up empty for a frame
+    int *scroll = x_axis ? &box->scroll.x : &box->scroll.y;
+    *scroll = _clamp_scroll(*scroll, _list_extent(count_items, list.item_extent), view);
+    int64_t begin = *scroll/list.item_extent;
+    int64_t end = ((int64_t)*scroll + view + list.item_extent - 1)/list.item_extent;
+    list.begin = (uint32_t)MY_MIN(begin, (int64_t)count_items);
+    list.end   = (uint32_t)MY_MIN(end,   (int64_t)count_items);
+
+    if(list.begin > 0) _open_spacer(ctx, x_axis, _list_extent(list.begin, list.item_extent));
+    return list;
+}
+
+void yui_end_virtual_list(yui_Ctx *ctx, const yui_VirtualList *list)
+{
+    bool x_axis = ctx->curr->style->config.content_dir == YUI_CONTENT_LEFT_TO_RIGHT;
+    if(list->end < list->count) _open_spacer(ctx, x_axis, _list_extent(list->count - list->end, list->item_extent));
+}
+
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define ALIGN8(N) (((N) + 7) & ~(uint64_t)7)
+_Static_assert(sizeof(int) == sizeof(int32_t), "measured widths are stored as int32_t");
+
+// Offsets of the records, widths and strings, returns the size of the whole snapshot
+internal uint64_t _snapshot_layout(const yui_SnapshotHeader *header, uint64_t *boxes, uint64_t *widths, uint64_t *text)
+{
+    *boxes  = ALIGN8(sizeof(*header));
+    *widths = ALIGN8(*boxes + (uint64_t)header->count_boxes*sizeof(yui_SnapshotBox));
+    *text   = ALIGN8(*widths + (uint64_t)header->count_widths*sizeof(int32_t));
+    return ALIGN8(*text + header->text_bytes);
+}
+
+// Pre-order, which is the order the boxes were opened in
+internal yui_Box *_next_in_tree(yui_Box *root, yui_Box *box)
+{
+    if(box->children.begin) return box->children.begin;
+    for(; box != root; box = box->parent)
+        if(box->next) return box->next;
+    return NULL;
+}
+
+size_t yui_write_snapshot(yui_Ctx *ctx, void *buffer, size_t size)
+{
+    yui_Box *root = &ctx->root;
+    yui_SnapshotHeader header = {
+        .magic = YUI_SNAPSHOT_MAGIC,
+        .version = YUI_SNAPSHOT_VERSION,
+        .byte_order = SNAPSHOT_BYTE_ORDER,
+        .root_width  = (uint32_t)root->fixed_width,
+        .root_height = (uint32_t)root->fixed_height,
+        .count_boxes = ctx->boxes.count,
+    };
+    uint64_t text_bytes = 0;
+    for(yui_Box *box = _next_in_tree(root, root); box != NULL; box = _next_in_tree(root, box)) {
+        if(box->text == NULL) continue;
+        header.count_widths += box->lines ? ctx->line_cache.items[box->lines].count_words + 1 : 1;
+        text_bytes += strlen(box->text) + 1;
+    }
+    assert(text_bytes <= UINT32_MAX && "Snapshot too large");
+    header.text_bytes = (uint32_t)text_bytes;
+    uint64_t boxes_offset, widths_offset, text_offset;
+    uint64_t total = _snapshot_layout(&header, &boxes_offset, &widths_offset, &text_offset);
+    assert(total <= UINT32_MAX && "Snapshot too large");
+    header.size = (uint32_t)total;
+    if(buffer == NULL || size < total) return (size_t)total;
+
+    uint8_t *base = buffer;
+    memset(base, 0, (size_t)total);
+    yui_SnapshotBox *records = (yui_SnapshotBox *)(base + boxes_offset);
+    int32_t *widths = (int32_t *)(base + widths_offset);
+    char *text = (char *)(base + text_offset);
+    uint32_t count_widths = 0;
+    uint32_t count_text = 0;
+    void **fonts = NULL;
+    uint32_t cap_fonts = 0;
+    for(yui_Box *box = _next_in_tree(root, root); box != NULL; box = _next_in_tree(root, box)) {
+        const yui_BoxConfig *c = &box->style->config;
+        yui_SnapshotBox *r = &records[box->id - 1];
+        // Derived keys come back by themselves
+        r->key = box->retained ? box->key : 0;
+        r->parent = box->parent->id;
+        r->text = UINT32_MAX;
+        r->font_size = c->text.font_size;
+        r->fixed_width  = box->fixed_width;
+        r->fixed_height = box->fixed_height;
+        r->padding[0] = c->padding.l; r->padding[1] = c->padding.t; r->padding[2] = c->padding.r; r->padding[3] = c->padding.b;
+        r->margin[0]  = c->margin.l;  r->margin[1]  = c->margin.t;  r->margin[2]  = c->margin.r;  r->margin[3]  = c->margin.b;
+        r->border_width = c->border_width;
+        r->roundness = c->roundness;
+        r->scroll[0] = box->scroll.x;
+        r->scroll[1] = box->scroll.y;
+        r->overflow[0] = (uint8_t)c->overflow.x_axis;
+        r->overflow[1] = (uint8_t)c->overflow.y_axis;
+        r->sizing[0] = (uint8_t)c->sizing.x_axis;
+        r->sizing[1] = (uint8_t)c->sizing.y_axis;
+        r->content_dir = (uint8_t)c->content_dir;
+        r->wrap = c->text.wrap;
+        r->background_color = c->background_color;
+        r->border_color = c->border_color;
+        r->text_color = c->text.color;
+        if(c->text.font) {
+            uint32_t i = 0;
+            while(i < header.count_fonts && fonts[i] != c->text.font) ++i;
+            if(i == header.count_fonts) {
+                if(i == cap_fonts) {
+                    cap_fonts = cap_fonts ? cap_fonts*2 : 8;
+                    GROW_ARRAY(fonts, cap_fonts);
+                }
+                fonts[header.count_fonts++] = c->text.font;
+            }
+            r->font = i + 1;
+        }
+        if(box->text == NULL) continue;
+
+        // Text boxes replay from their text config, so what layout changed in the config of
+        // wrapped text does not matter
+        uint32_t length = (uint32_t)strlen(box->text);
+        memcpy(text + count_text, box->text, length + 1);
+        r->text = count_text;
+        count_text += length + 1;
+        r->widths = count_widths;
+        if(box->lines) {
+            const yui_LineCacheEntry *entry = &ctx->line_cache.items[box->lines];
+            r->count_widths = entry->count_words + 1;
+            memcpy(widths + count_widths, entry->word_widths, r->count_widths*sizeof(*widths));
+        } else {
+            r->count_widths = 1;
+            widths[count_widths] = box->fixed_width;
+        }
+        count_widths += r->count_widths;
+    }
+    YUI_FREE(fonts);
+    memcpy(base, &header, sizeof(header));
+    return (size_t)total;
+}
+
+internal uint32_t _count_words(const char *text)
+{
+    uint32_t count = 1;
+    for(; *text; ++text) count += *text == ' ' || *text == '\n';
+    return count;
+}
+
+internal bool _check_snapshot(const yui_SnapshotHeader *header, const yui_SnapshotBox *records, const char *text)
+{
+    for(uint32_t i = 0; i < header->count_boxes; ++i) {
+        const yui_SnapshotBox *r = &records[i];
+        if(r->parent > i || r->font > header->count_fonts) return false;
+        if(r->overflow[0] > YUI_OVERFLOW_SCROLL || r->overflow[1] > YUI_OVERFLOW_SCROLL) return false;
+        if(r->sizing[0] > YUI_BOX_SIZING_GROW || r->sizing[1] > YUI_BOX_SIZING_GROW) return false;
+        if(r->content_dir > YUI_CONTENT_LEFT_TO_RIGHT) return false;
+        // Pre-order: the parent is the previous box or one of its ancestors, walking up
+        // closes boxes so the walks add up to the number of boxes
+        uint32_t q = i;
+        while(q > r->parent) q = records[q - 1].parent;
+        if(q != r->parent) return false;
+        if(r->parent > 0 && records[r->parent - 1].text != UINT32_MAX) return false;
+        if(r->text == UINT32_MAX) continue;
+        if(r->text >= header->text_bytes) return false;
+        if(r->widths > header->count_widths || r->count_widths > header->count_widths - r->widths) return false;
+        uint32_t needed = r->wrap ? _count_words(text + r->text) + 1 : 1;
+        if(r->count_widths != needed) return false;
+    }
+    return true;
+}
+
+bool yui_load_snapshot(yui_Ctx *ctx, const void *data, size_t size, void *const *fonts, uint32_t count_fonts)
+{
+    const yui_SnapshotHeader *header = data;
+    if(((uintptr_t)data & 7) != 0 || size < sizeof(*header)) return false;
+    if(header->magic != YUI_SNAPSHOT_MAGIC || header->version != YUI_SNAPSHOT_VERSION) return false;
+    if(header->byte_order != SNAPSHOT_BYTE_ORDER) return false;
+    uint64_t boxes_offset, widths_offset, text_offset;
+    uint64_t total = _snapshot_layout(header, &boxes_offset, &widths_offset, &text_offset);
+    if(total != header->size || total > size) return false;
+    const uint8_t *base = data;
+    const yui_SnapshotBox *records = (const yui_SnapshotBox *)(base + boxes_offset);
+    const int32_t *widths = (const int32_t *)(base + widths_offset);
+    const char *text = (const char *)(base + text_offset);
+    // Every string ends inside the block when the last byte ends one
+    if(header->text_bytes > 0 && text[header->text_bytes - 1] != 0) return false;
+    if(!_check_snapshot(header, records, text)) return false;
+
+    yui_begin_frame(ctx, header->root_width, header->root_height);
+    for(uint32_t i = 0; i < header->count_boxes; ++i) {
+        const yui_SnapshotBox *r = &records[i];
+        while(ctx->curr->id != r->parent) yui_close_box(ctx);
+        void *font = NULL;
+        if(r->font) font = r->font <= count_fonts && fonts ? fonts[r->font - 1] : (void *)(uintptr_t)r->font;
+        yui_TextConfig text_config = { .font = font, .font_size = r->font_size, .color = r->text_color, .wrap = r->wrap };
+        if(r->text != UINT32_MAX) {
+            _text_box(ctx, text + r->text, text_config, widths + r->widths);
+            continue;
+        }
+        yui_BoxConfig config = {
+            .overflow = { r->overflow[0], r->overflow[1] },
+            .sizing = { r->sizing[0], r->sizing[1] },
+            .content_dir = r->content_dir,
+            .fixed_width  = r->fixed_width,
+            .fixed_height = r->fixed_height,
+            .padding = { r->padding[0], r->padding[1], r->padding[2], r->padding[3] },
+            .margin  = { r->margin[0],  r->margin[1],  r->margin[2],  r->margin[3] },
+            .background_color = r->background_color,
+            .roundness = r->roundness,
+            .border_width = r->border_width,
+            .border_color = r->border_color,
+            .text = text_config,
+        };
+        yui_Box *box = _open_styled(ctx, r->key, _frame_style(ctx, &config));
+        if(r->scroll[0] || r->scroll[1]) yui_set_scroll(ctx, box, (yui_Point){ r->scroll[0], r->scroll[1] });
+    }
+    while(ctx->curr != &ctx->root) yui_close_box(ctx);
+    return true;
+}
+
+internal void _compute_fit_sizing(yui_Ctx *ctx, yui_Box *box)
+{
+    // An unchanged subtree has the same fit size as last frame. Its children are only sized
+    // when the grow pass can't move it as it was, see _move_unchanged.
+    if(box->clean) {
+        yui_Point fit = ctx->retained.items[box->retained].fit;
+        box->layout.padding_box = (yui_Rect){ 0, 0, fit.x, fit.y };
+        return;
+    }
+
+    // Wrapped text fits its widest line
+    int content_width  = box->lines ? box->fixed_width : 0;
+    int content_height = 0;
+    for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
+        // Items of a parallel frame are done by then
+        if(child->task == 0) _compute_fit_sizing(ctx, child);
+        int child_margin_box_width  = child->layout.padding_box.w + child->style->margin[0];
+        int child_margin_box_height = child->layout.padding_box.h + child->style->margin[1];
+
+        if(box->style->config.content_dir == YUI_CONTENT_LEFT_TO_RIGHT) {
+            content_width  += child_margin_box_width;
+            content_height  = MY_MAX(content_height, child_margin_box_height);
+        } else {
+            content_width   = MY_MAX(content_width, child_margin_box_width);
+            content_height += child_margin_box_height;
+        }
+    }
+
+    // A GROW box that scrolls only gets the free space, its content goes past it
+    if(box->style->config.sizing.x_axis == YUI_BOX_SIZING_GROW && box->style->config.overflow.x_axis == YUI_OVERFLOW_SCROLL) content_width = 0;
+    if(box->style->config.sizing.y_axis == YUI_BOX_SIZING_GROW && box->style->config.overflow.y_axis == YUI_OVERFLOW_SCROLL) content_height = 0;
+    if(box->style->config.sizing.x_axis == YUI_BOX_SIZING_FIXED) content_width  = box->fixed_width;
+    if(box->style->config.sizing.y_axis == YUI_BOX_SIZING_FIXED) content_height = box->fixed_height;
+    // The frame can be laid out twice, see yui_end_frame. Children of a FIXED box are never
+    // positioned on that axis, they stay at 0 like in the flat engine.
+    box->layout.padding_box = (yui_Rect){ 0, 0, content_width + box->style->padding[0], content_height + box->style->padding[1] };
+    // Kept here rather than in the grow pass, which can skip culled subtrees
+    if(box->retained) ctx->retained.items[box->retained].fit = (yui_Point){ box->layout.padding_box.w, box->layout.padding_box.h };
+}
+
+// Sums up the fit sizes of the children of `box` before the grow pass changes them, see
+// yui_LayoutCursor. The cursor starts once `box` itself is placed.
+internal yui_LayoutCursor _begin_children(yui_Box *box)
+{
+    yui_LayoutCursor cursor = {0};
+    cursor.content[0] = box->layout.padding_box.w - box->style->padding[0];
+    cursor.content[1] = box->layout.padding_box.h - box->style->padding[1];
+    bool left_to_right = box->style->config.content_dir == YUI_CONTENT_LEFT_TO_RIGHT;
+    for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
+        int width  = child->layout.padding_box.w + child->style->margin[0];
+        int height = child->layout.padding_box.h + child->style->margin[1];
+        if(left_to_right) {
+            cursor.filled[0] += width;
+            cursor.filled[1]  = MY_MAX(cursor.filled[1], height);
+        } else {
+            cursor.filled[0]  = MY_MAX(cursor.filled[0], width);
+            cursor.filled[1] += height;
+        }
+        cursor.count_grow[0] += child->style->config.sizing.x_axis == YUI_BOX_SIZING_GROW;
+        cursor.count_grow[1] += child->style->config.sizing.y_axis == YUI_BOX_SIZING_GROW;
+    }
+    return cursor;
+}
+
+// Sizes `box` on one axis once its parent is final, `cursor` is the parent's
+internal void _compute_grow_sizing_on(yui_Box *parent, const yui_LayoutCursor *cursor, yui_Box *box, bool x_axis)
+{
+    int a = x_axis ? 0 : 1;
+    yui_BoxSizing sizing = x_axis ? box->style->config.sizing.x_axis : box->style->config.sizing.y_axis;
+    yui_ContentDirection aligned_direction = YUI_CONTENT_LEFT_TO_RIGHT;
+    if(!x_axis) aligned_direction = YUI_CONTENT_TOP_TO_BOTTOM;
+    int *size = x_axis ? &box->layout.padding_box.w : &box->layout.padding_box.h;
+    if(sizing == YUI_BOX_SIZING_GROW && parent) {
+        // TODO: For GROW boxes this makes the padding box & margin box bigger than the parent's
+        //       content box, padding and margin should come out of the free space instead
+        if(parent->style->config.content_dir == aligned_direction) {
+            *size += (cursor->content[a] - cursor->filled[a])/(int)cursor->count_grow[a];
+        } else {
+            *size = cursor->content[a] + box->style->padding[a];
+        }
+    }
+}
+
+// Places `box` on one axis at the parent's cursor and moves the cursor past it along the
+// parent's content direction
+internal void _compute_pos_on(yui_Box *parent, yui_LayoutCursor *cursor, yui_Box *box, bool x_axis)
+{
+    bool left_to_right = parent->style->config.content_dir == YUI_CONTENT_LEFT_TO_RIGHT;
+    if(x_axis) {
+        box->layout.padding_box.x = cursor->cursor[0] + box->style->config.margin.l;
+        if(left_to_right) cursor->cursor[0] += box->layout.padding_box.w + box->style->margin[0];
+    } else {
+        box->layout.padding_box.y = cursor->cursor[1] + box->style->config.margin.t;
+        if(!left_to_right) cursor->cursor[1] += box->layout.padding_box.h + box->style->margin[1];
+    }
+}
+
+internal void _execute_command(yui_Ctx *ctx, const yui_DrawCommand *cmd)
+{
+    switch(cmd->kind) {
+    case YUI_DRAW_RECT:
+        draw_rect(ctx, cmd->rect, cmd->color, cmd->roundness);
+        break;
+    case YUI_DRAW_RECT_OUTLINE:
+        draw_rect_outline(ctx, cmd->rect, cmd->color, cmd->border_width);
+        break;
+    case YUI_DRAW_TEXT:
+        draw_text(ctx, cmd->text.font, cmd->text.str, cmd->text.font_size, cmd->rect.x, cmd->rect.y, cmd->color);
+        break;
+    case YUI_DRAW_SCISSOR_PUSH:
+        begin_scissor_mode(ctx, cmd->rect);
+        break;
+    case YUI_DRAW_SCISSOR_POP:
+        if(cmd->restore) begin_scissor_mode(ctx, cmd->rect);
+        else end_scissor_mode(ctx);
+        break;
+    }
+}
+
+void yui_replay(yui_Ctx *ctx, const yui_DrawCommand *commands, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; ++i)
+        _execute_command(ctx, &commands[i]);
+}
+
+internal void _push_command(yui_Ctx *ctx, yui_DrawCommand cmd)
+{
+    yui_DrawList *list = &ctx->draw_list;
+    ctx->stats.count_draw_commands += 1;
+    if(list->items == NULL) {
+        _execute_command(ctx, &cmd);
+        return;
+    }
+    list->required += 1;
+    if(list->count < list->cap)
+        list->items[list->count++] = cmd;
+}
+
+internal inline yui_Rect _intersect_rect(yui_Rect a, yui_Rect b)
+{
+    int l = MY_MAX(a.x, b.x);
+    int t = MY_MAX(a.y, b.y);
+    int r = MY_MIN(a.x + a.w, b.x + b.w);
+    int d = MY_MIN(a.y + a.h, b.y + b.h);
+    return (yui_Rect){ l, t, MY_MAX(r - l, 0), MY_MAX(d - t, 0) };
+}
+
+internal inline bool _rects_overlap(yui_Rect a, yui_Rect b)
+{
+    return a.w > 0 && a.h > 0 && b.w > 0 && b.h > 0 &&
+        a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+internal inline bool _box_clips(yui_Box *box)
+{
+    return box->style->config.overflow.x_axis != YUI_OVERFLOW_VISIBLE || box->style->config.overflow.y_axis != YUI_OVERFLOW_VISIBLE;
+}
+
+// The clip rect the children of `box` are drawn under
+internal yui_Rect _child_clip(yui_Box *box, yui_Rect clip)
+{
+    if(!_box_clips(box)) return clip;
+    yui_Rect bounds = box->layout.padding_box;
+    if(box->style->config.overflow.x_axis == YUI_OVERFLOW_VISIBLE) { bounds.x = clip.x; bounds.w = clip.w; }
+    if(box->style->config.overflow.y_axis == YUI_OVERFLOW_VISIBLE) { bounds.y = clip.y; bounds.h = clip.h; }
+    return _intersect_rect(clip, bounds);
+}
+
+// A box whose margin box lies outside the clip rect is skipped together with its children,
+// so content overflowing a VISIBLE box past its margin box goes with it. An empty margin box
+// still counts as inside, a GROW box shrunk to nothing can have children overflowing it.
+internal inline bool _is_culled(yui_Ctx *ctx, yui_Box *box, yui_Rect clip)
+{
+    yui_Rect r = yui_margin_box(box);
+    return !ctx->draw_offscreen && (clip.w <= 0 || clip.h <= 0 ||
+        r.x >= clip.x + clip.w || r.x + r.w < clip.x || r.y >= clip.y + clip.h || r.y + r.h < clip.y);
+}
+
+// Emits what `box` draws before its children. Returns whether the children are drawn and
+// the scissor they are drawn under.
+internal bool _render_box_begin(yui_Ctx *ctx, yui_Box *box, yui_Rect clip, yui_Rect *child_clip)
+{
+    TRACE_BOX(ctx, box);
+    ctx->stats.count_drawn_boxes += 1;
+    *child_clip = clip;
+    if(box->lines) {
+        const yui_LineCacheEntry *entry = &ctx->line_cache.items[box->lines];
+        int font_size = box->style->config.text.font_size;
+        int line_height = _line_height(ctx, box->style->config.text.font, font_size);
+        yui_Rect rect = yui_content_box(box);
+        rect.h = line_height;
+        for(uint32_t i = 0; i < entry->count_lines; ++i, rect.y += line_height) {
+            if(!ctx->draw_offscreen && !_rects_overlap(rect, clip)) continue;
+            _push_command(ctx, (yui_DrawCommand){ .kind = YUI_DRAW_TEXT, .color = box->style->config.text.color,
+                    .rect = rect, .text = { box->style->config.text.font, entry->text + entry->lines[i], font_size } });
+        }
+        return false;
+    }
+    if(box->text) {
+        _push_command(ctx, (yui_DrawCommand){ .kind = YUI_DRAW_TEXT, .color = box->style->config.text.color,
+                .rect = yui_content_box(box),
+                .text = { box->style->config.text.font, box->text, box->style->config.text.font_size } });
+        return false;
+    }
+    _push_command(ctx, (yui_DrawCommand){ .kind = YUI_DRAW_RECT, .color = box->style->config.background_color,
+            .rect = box->layout.padding_box, .roundness = box->style->config.roundness });
+    if(box->style->config.border_width > 0) {
+        _push_command(ctx, (yui_DrawCommand){ .kind = YUI_DRAW_RECT_OUTLINE, .color = box->style->config.border_color,
+                .rect = box->layout.padding_box, .border_width = box->style->config.border_width });
+    }
+
+    if(_box_clips(box)) {
+        *child_clip = _child_clip(box, clip);
+        _push_command(ctx, (yui_DrawCommand){ .kind = YUI_DRAW_SCISSOR_PUSH, .rect = *child_clip });
+    }
+    return true;
+}
+
+internal void _render_box_end(yui_Ctx *ctx, yui_Box *box, yui_Rect clip, bool clipped)
+{
+    if(_box_clips(box)) {
+        _push_command(ctx, (yui_DrawCommand){ .kind = YUI_DRAW_SCISSOR_POP, .rect = clip, .restore = clipped });
+    }
+}
+
+internal void _render(yui_Ctx *ctx, yui_Box *box, yui_Rect clip, bool clipped)
+{
+    if(box != &ctx->root && _is_culled(ctx, box, clip)) return;
+    yui_Rect child_clip;
+    if(!_render_box_begin(ctx, box, clip, &child_clip)) return;
+    bool child_clipped = clipped || _box_clips(box);
+    for(yui_Box *child = box->children.begin; child != NULL; child = child->next)
+        _render(ctx, child, child_clip, child_clipped);
+    _render_box_end(ctx, box, clip, clipped);
+}
+
+// Breaks the text of `box` at the width layout gave it. When that takes another number of
+// lines than its height has room for the frame is laid out again with the new height.
+internal void _wrap_text_box(yui_Ctx *ctx, yui_Box *box)
+{
+    box->lines = _wrap_lines(ctx, box->lines, box->text, yui_content_box(box).w);
+    int line_height = _line_height(ctx, box->style->config.text.font, box->style->config.text.font_size);
+    int height = (int)ctx->line_cache.items[box->lines].count_lines*line_height;
+    // A restored layout can already have the height the guess did not
+    box->fixed_height = height;
+    if(ctx->flat.active) ctx->flat.axis[1].fixed[box->id] = height;
+    if(height == yui_content_box(box).h) return;
+    for(yui_Box *b = box; b != NULL; b = b->parent) b->clean = false;
+    ctx->relayout = true;
+}
+
+enum {
+    LAYOUT_POS_X     = 1 << 0,
+    LAYOUT_POS_Y     = 1 << 1,
+    LAYOUT_RENDER    = 1 << 2,
+};
+
+// The axes the children of `box` are positioned on when `box` was positioned on `flags`.
+// Children of a FIXED box are not positioned on that axis unless it scrolls.
+internal inline uint32_t _child_pos_flags(const yui_Box *box, uint32_t flags)
+{
+    const yui_BoxConfig *config = &box->style->config;
+    uint32_t child_flags = 0;
+    if(flags & LAYOUT_POS_X && (config->sizing.x_axis != YUI_BOX_SIZING_FIXED || config->overflow.x_axis == YUI_OVERFLOW_SCROLL))
+        child_flags |= LAYOUT_POS_X;
+    if(flags & LAYOUT_POS_Y && (config->sizing.y_axis != YUI_BOX_SIZING_FIXED || config->overflow.y_axis == YUI_OVERFLOW_SCROLL))
+        child_flags |= LAYOUT_POS_Y;
+    return child_flags;
+}
+
+internal inline void _wrap_or_defer(yui_Ctx *ctx, yui_Box *box)
+{
+    // Line breaking shares the line cache, tasks leave it to the calling thread
+    if(ctx->parallel.active) box->wrap_pending = true;
+    else _wrap_text_box(ctx, box);
+}
+
+// A culled subtree keeps its fit layout and is missing from the kept layouts, a hash that
+// cannot match makes next frame lay out the keyed boxes above it instead of moving them.
+// Tasks leave the boxes above their item to the calling thread.
+internal void _invalidate_culled(yui_Ctx *ctx, yui_Box *box)
+{
+    for(yui_Box *b = box; b != NULL; b = b->parent) {
+        if(b->retained) {
+            yui_Retained *entry = &ctx->retained.items[b->retained];
+            // Invalidated before, and so was everything above it
+            if(entry->hash != b->hash) return;
+            entry->hash = ~b->hash;
+        }
+        if(b->task) {
+            ctx->parallel.items[b->task - 1].culled = true;
+            return;
+        }
+    }
+}
+
+// `offset` takes the id of a box to its id last frame, `flags` are the axes `box` is
+// positioned on
+internal void _move_children(yui_Ctx *ctx, yui_Box *box, uint32_t offset, yui_Point delta, uint32_t flags)
+{
+    uint32_t child_flags = _child_pos_flags(box, flags);
+    for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
+        yui_Rect rect = ctx->kept.prev[child->id + offset];
+        if(child_flags & LAYOUT_POS_X) rect.x += delta.x;
+        if(child_flags & LAYOUT_POS_Y) rect.y += delta.y;
+        child->layout.padding_box = rect;
+        ctx->kept.curr[child->id] = rect;
+        if(child->retained) {
+            yui_Retained *entry = &ctx->retained.items[child->retained];
+            entry->placed = child_flags;
+            entry->placed_frame = ctx->frame;
+        }
+        if(child->lines) _wrap_or_defer(ctx, child);
+        if(child->children.begin) _move_children(ctx, child, offset, delta, child_flags);
+    }
+}
+
+// An unchanged subtree that the grow pass gave the size and placement it had last frame
+// has last frame's layout, moved by as much as `box` moved. Its scroll offsets are the ones
+// it was clamped to then. Returns false when the subtree has to be laid out after all.
+internal bool _move_unchanged(yui_Ctx *ctx, yui_Box *box, uint32_t placed)
+{
+    yui_Retained *entry = &ctx->retained.items[box->retained];
+    const yui_KeptLayouts *kept = &ctx->kept;
+    if(entry->placed_frame < ctx->layout_frame || entry->placed != placed) return false;
+    if(entry->prev_id + box->count_subtree > kept->count_prev) return false;
+    yui_Rect last = kept->prev[entry->prev_id];
+    yui_Rect rect = box->layout.padding_box;
+    if(last.w != rect.w || last.h != rect.h) return false;
+    entry->placed_frame = ctx->frame;
+    if(box->lines) _wrap_or_defer(ctx, box);
+    _move_children(ctx, box, entry->prev_id - box->id, (yui_Point){ rect.x - last.x, rect.y - last.y }, placed);
+    return true;
+}
+
+// Grow sizing, positioning and optionally rendering in a single top-down walk. A box only
+// needs its parent to be final, and siblings before it to have moved the parent's cursor.
+internal void _compute_grow_and_pos(yui_Ctx *ctx, yui_Box *parent, yui_LayoutCursor *cursor, yui_Box *box, uint32_t flags, yui_Rect clip, bool clipped)
+{
+    _compute_grow_sizing_on(parent, cursor, box, true);
+    _compute_grow_sizing_on(parent, cursor, box, false);
+    if(flags & LAYOUT_POS_X) _compute_pos_on(parent, cursor, box, true);
+    if(flags & LAYOUT_POS_Y) _compute_pos_on(parent, cursor, box, false);
+    uint32_t placed = flags & (LAYOUT_POS_X | LAYOUT_POS_Y);
+    if(ctx->kept.active) ctx->kept.curr[box->id] = box->layout.padding_box;
+    if(box->clean) {
+        if(_move_unchanged(ctx, box, placed)) {
+            if(flags & LAYOUT_RENDER) _render(ctx, box, clip, clipped);
+            return;
+        }
+        // Fit sizing left the children alone, they are laid out after all
+        for(yui_Box *child = box->children.begin; child != NULL; child = child->next)
+            _compute_fit_sizing(ctx, child);
+    }
+    if(box->retained) {
+        yui_Retained *entry = &ctx->retained.items[box->retained];
+        entry->placed = placed;
+        entry->placed_frame = ctx->frame;
+    }
+    if(box->lines) _wrap_or_defer(ctx, box);
+    yui_LayoutCursor children;
+    if(box->children.begin) children = _begin_children(box);
+    else children.filled[0] = children.filled[1] = 0;
+    if(_box_scrolls(box)) {
+        yui_Rect content = yui_content_box(box);
+        if(box->style->config.overflow.x_axis == YUI_OVERFLOW_SCROLL)
+            box->scroll.x = _clamp_scroll(box->scroll.x, children.filled[0], content.w);
+        if(box->style->config.overflow.y_axis == YUI_OVERFLOW_SCROLL)
+            box->scroll.y = _clamp_scroll(box->scroll.y, children.filled[1], content.h);
+        _save_scroll(ctx, box);
+    }
+    uint32_t child_flags = (flags & LAYOUT_RENDER) | _child_pos_flags(box, flags);
+    // The root is sized like any other box but never positioned, its children are
+    if(parent == NULL) {
+        child_flags |= LAYOUT_POS_X | LAYOUT_POS_Y;
+        clip = box->layout.padding_box;
+    } else if((flags & LAYOUT_RENDER || ctx->cull_layout) && _is_culled(ctx, box, clip)) {
+        // Only a box placed on both axes has a rect that says where its children end up
+        if(ctx->cull_layout && placed == (LAYOUT_POS_X | LAYOUT_POS_Y)) {
+            _invalidate_culled(ctx, box);
+            return;
+        }
+        flags &= ~LAYOUT_RENDER;
+        child_flags &= ~LAYOUT_RENDER;
+    }
+    if(box->children.begin == NULL) {
+        yui_Rect child_clip;
+        if(flags & LAYOUT_RENDER && _render_box_begin(ctx, box, clip, &child_clip)) _render_box_end(ctx, box, clip, clipped);
+        return;
+    }
+    // The children of a box that scrolls start `scroll` before its content
+    children.cursor[0] = box->layout.padding_box.x + box->style->config.padding.l - box->scroll.x;
+    children.cursor[1] = box->layout.padding_box.y + box->style->config.padding.t - box->scroll.y;
+
+    yui_Rect child_clip = _child_clip(box, clip);
+    bool child_clipped = clipped || _box_clips(box);
+    if(box->task) {
+        yui_ParallelItem *item = &ctx->parallel.items[box->task - 1];
+        *item = (yui_ParallelItem){ box, child_flags, children, child_clip, child_clipped, true, false };
+        return;
+    }
+    if(flags & LAYOUT_RENDER) {
+        if(!_render_box_begin(ctx, box, clip, &child_clip)) child_flags &= ~LAYOUT_RENDER;
+    }
+    for(yui_Box *child = box->children.begin; child != NULL; child = child->next)
+        _compute_grow_and_pos(ctx, box, &children, child, child_flags, child_clip, child_clipped);
+    if(child_flags & LAYOUT_RENDER) _render_box_end(ctx, box, clip, clipped);
+}
+
+internal void _split_parallel(yui_Ctx *ctx, yui_Box *box, uint32_t threshold, uint32_t *size)
+{
+    yui_Parallel *parallel = &ctx->parallel;
+    for(yui_Box *child = box->children.begin; child != NULL; child = child->next) {
+        if(child->count_subtree > threshold && !child->clean) {
+            _split_parallel(ctx, child, threshold, size);
+            continue;
+        }
+        if(parallel->count == parallel->cap) {
+            parallel->cap = parallel->cap ? parallel->cap*2 : 256;
+            GROW_ARRAY(parallel->items, parallel->cap);
+        }
+        parallel->items[parallel->count++] = (yui_ParallelItem){ .box = child };
+        child->task = parallel->count;
+        *size += child->count_subtree;
+        if(*size >= threshold) {
+            if(parallel->count_tasks + 1 == parallel->cap_tasks) {
+                parallel->cap_tasks *= 2;
+                GROW_ARRAY(parallel->tasks, parallel->cap_tasks);
+            }
+            parallel->tasks[++parallel->count_tasks] = parallel->count;
+            *size = 0;
+        }
+    }
+}
+
+// Decides whether the frame is worth splitting, see yui_Parallel
+internal void _begin_parallel(yui_Ctx *ctx)
+{
+    yui_Parallel *parallel = &ctx->parallel;
+    yui_Box *root = &ctx->root;
+    uint32_t threshold = ctx->parallel_threshold ? ctx->parallel_threshold : YUI_PARALLEL_THRESHOLD;
+    parallel->active = false;
+    parallel->count = 0;
+    parallel->count_tasks = 0;
+    if(ctx->config.parallel_for == NULL || root->count_subtree <= threshold) return;
+
+    if(parallel->cap_tasks == 0) {
+        parallel->cap_tasks = 64;
+        GROW_ARRAY(parallel->tasks, parallel->cap_tasks);
+    }
+    parallel->tasks[0] = 0;
+    uint32_t size = 0;
+    _split_parallel(ctx, root, threshold, &size);
+    if(size > 0) {
+        if(parallel->count_tasks + 1 == parallel->cap_tasks) {
+            parallel->cap_tasks *= 2;
+            GROW_ARRAY(parallel->tasks, parallel->cap_tasks);
+        }
+        parallel->tasks[++parallel->count_tasks] = parallel->count;
+    }
+    // A single task only adds the cost of handing it over
+    parallel->active = parallel->count_tasks > 1;
+    if(!parallel->active) {
+        for(uint32_t i = 0; i < parallel->count; ++i) parallel->items[i].box->task = 0;
+    }
+}
+
+internal void _fit_task(void *data, uint32_t index)
+{
+    yui_Ctx *ctx = data;
+    const yui_Parallel *parallel = &ctx->parallel;
+    for(uint32_t i = parallel->tasks[index]; i < parallel->tasks[index + 1]; ++i)
+        _compute_fit_sizing(ctx, parallel->items[i].box);
+}
+
+internal void _grow_and_pos_task(void *data, uint32_t index)
+{
+    yui_Ctx *ctx = data;
+    const yui_Parallel *parallel = &ctx->parallel;
+    for(uint32_t i = parallel->tasks[index]; i < parallel->tasks[index + 1]; ++i) {
+        yui_ParallelItem *item = &parallel->items[i];
+        if(!item->placed) continue;
+        for(yui_Box *child = item->box->children.begin; child != NULL; child = child->next)
+            _compute_grow_and_pos(ctx, item->box, &item->cursor, child, item->flags, item->clip, item->clipped);
+    }
+}
+
+// The items of a parallel frame first, then the boxes above them on this thread
+internal void _layout_fit(yui_Ctx *ctx)
+{
+    yui_Parallel *parallel = &ctx->parallel;
+    if(parallel->active) {
+        ctx->config.parallel_for(ctx->config.parallel_user, _fit_task, ctx, parallel->count_tasks);
+        ctx->stats.count_tasks += parallel->count_tasks;
+    }
+    _compute_fit_sizing(ctx, &ctx->root);
+}
+
+// Sizes the kept layouts for the boxes of this frame, see yui_KeptLayouts
+internal void _begin_kept(yui_Ctx *ctx)
+{
+    yui_KeptLayouts *kept = &ctx->kept;
+    uint32_t count = ctx->boxes.count + 1;
+    kept->active = ctx->retained.live > 0;
+    if(kept->active && count > kept->cap) {
+        kept->cap = MY_MAX(count, 2*kept->cap);
+        GROW_ARRAY(kept->prev, kept->cap);
+        GROW_ARRAY(kept->curr, kept->cap);
+    }
+}
+
+internal void _end_kept(yui_Ctx *ctx)
+{
+    yui_KeptLayouts *kept = &ctx->kept;
+    kept->count_prev = 0;
+    if(!kept->active) return;
+    yui_Rect *prev = kept->prev;
+    kept->prev = kept->curr;
+    kept->curr = prev;
+    kept->count_prev = ctx->boxes.count + 1;
+    kept->active = false;
+}
+
+// The boxes above the items of a parallel frame first, then everything below them
+internal void _layout_grow_and_pos(yui_Ctx *ctx, uint32_t flags)
+{
+    yui_Parallel *parallel = &ctx->parallel;
+    for(uint32_t i = 0; i < parallel->count; ++i) parallel->items[i].placed = parallel->items[i].culled = false;
+    _compute_grow_and_pos(ctx, NULL, NULL, &ctx->root, flags, (yui_Rect){0}, false);
+    if(!parallel->active) return;
+    ctx->config.parallel_for(ctx->config.parallel_user, _grow_and_pos_task, ctx, parallel->count_tasks);
+    ctx->stats.count_tasks += parallel->count_tasks;
+    for(uint32_t i = 0; i < parallel->count; ++i)
+        if(parallel->items[i].culled) _invalidate_culled(ctx, parallel->items[i].box->parent);
+    // In the order a serial layout reaches them, which is the order they were opened in
+    for(uint32_t i = 0; i < ctx->count_wrapped; ++i) {
+        yui_Box *box = ctx->wrap_guesses[i].box;
+        if(!box->wrap_pending) continue;
+        box->wrap_pending = false;
+        _wrap_text_box(ctx, box);
+    }
+}
+
+internal uint32_t _command_state(const yui_DrawCommand *cmd, void **fonts, uint32_t *count_fonts)
+{
+    switch(cmd->kind) {
+    case YUI_DRAW_RECT: return cmd->roundness > 0 ? 1 : 0;
+    case YUI_DRAW_RECT_OUTLINE: return 2;
+    case YUI_DRAW_TEXT: {
+        uint32_t i = 0;
+        while(i < *count_fonts && fonts[i] != cmd->text.font) ++i;
+        if(i == *count_fonts) {
+            if(*count_fonts == YUI_SORT_FONTS_CAP) return 3 + YUI_SORT_FONTS_CAP;
+            fonts[(*count_fonts)++] = cmd->text.font;
+        }
+        return 3 + i;
+    }
+    default: return 0;
+    }
+}
+
+internal void _merge_sort_commands(yui_DrawCommand *items, uint64_t *keys, yui_DrawCommand *tmp, uint64_t *tmp_keys, uint32_t count)
+{
+    if(count < 2) return;
+    uint32_t half = count/2;
+    _merge_sort_commands(items, keys, tmp, tmp_keys, half);
+    _merge_sort_commands(items + half, keys + half, tmp, tmp_keys, count - half);
+    uint32_t i = 0, j = half, k = 0;
+    while(i < half && j < count) {
+        if(keys[j] < keys[i]) { tmp[k] = items[j]; tmp_keys[k++] = keys[j++]; }
+        else                  { tmp[k] = items[i]; tmp_keys[k++] = keys[i++]; }
+    }
+    while(i < half)  { tmp[k] = items[i]; tmp_keys[k++] = keys[i++]; }
+    while(j < count) { tmp[k] = items[j]; tmp_keys[k++] = keys[j++]; }
+    for(k = 0; k < count; ++k) { items[k] = tmp[k]; keys[k] = tmp_keys[k]; }
+}
+
+// Every command gets a layer that is at least the layer of any earlier command it overlaps,
+// one more when their states differ. A stable sort on (layer, state) then groups equal
+// states without ever drawing a command before something it overlapped in painter's order.
+// Scissor commands are barriers, nothing moves across them.
+internal void _sort_draw_list(yui_DrawList *list)
+{
+    if(list->count < 2) return;
+    if(list->scratch_cap < list->count) {
+        YUI_FREE(list->scratch);
+        YUI_FREE(list->keys);
+        list->scratch = YUI_MALLOC(list->count*sizeof(*list->scratch));
+        list->keys    = YUI_MALLOC(2*list->count*sizeof(*list->keys));
+        assert(list->scratch != NULL && list->keys != NULL && "Out of memory");
+        list->scratch_cap = list->count;
+    }
+
+    void *fonts[YUI_SORT_FONTS_CAP];
+    uint32_t count_fonts = 0;
+    uint64_t *keys = list->keys;
+    uint32_t begin = 0;
+    while(begin < list->count) {
+        uint32_t end = begin;
+        uint32_t floor = 0;
+        while(end < list->count && list->items[end].kind != YUI_DRAW_SCISSOR_PUSH && list->items[end].kind != YUI_DRAW_SCISSOR_POP) {
+            yui_DrawCommand *cmd = &list->items[end];
+            uint32_t state = _command_state(cmd, fonts, &count_fonts);
+            uint32_t layer = floor;
+            uint32_t window_begin = end - begin > YUI_SORT_WINDOW ? end - YUI_SORT_WINDOW : begin;
+            if(window_begin > begin) {
+                // Commands that fell out of the window are conservatively treated as overlapping
+                uint32_t evicted = (uint32_t)(keys[window_begin - 1] >> 32) + 1;
+                if(evicted > floor) floor = evicted;
+                if(floor > layer) layer = floor;
+            }
+            for(uint32_t i = window_begin; i < end; ++i) {
+                if(!_rects_overlap(list->items[i].rect, cmd->rect)) continue;
+                uint32_t other_layer = (uint32_t)(keys[i] >> 32);
+                uint32_t other_state = (uint32_t)keys[i];
+                uint32_t needed = other_state == state ? other_layer : other_layer + 1;
+                if(needed > layer) layer = needed;
+            }
+            keys[end] = (uint64_t)layer << 32 | state;
+            end += 1;
+        }
+        _merge_sort_commands(list->items + begin, keys + begin, list->scratch, keys + list->count, end - begin);
+        begin = end + 1;
+    }
+}
+
+internal inline yui_Rect _union_rect(yui_Rect a, yui_Rect b)
+{
+    int l = MY_MIN(a.x, b.x);
+    int t = MY_MIN(a.y, b.y);
+    int r = MY_MAX(a.x + a.w, b.x + b.w);
+    int d = MY_MAX(a.y + a.h, b.y + b.h);
+    return (yui_Rect){ l, t, r - l, d - t };
+}
+
+internal inline int64_t _rect_area(yui_Rect r)
+{
+    return (int64_t)r.w*r.h;
+}
+
+internal uint64_t _hash_command(const yui_DrawCommand *cmd, yui_Rect clip)
+{
+    uint64_t h = FNV_OFFSET;
+    h = _hash_mix(h, (uint64_t)cmd->kind | (uint64_t)cmd->color.r << 8 | (uint64_t)cmd->color.g << 16 |
+            (uint64_t)cmd->color.b << 24 | (uint64_t)cmd->color.a << 32);
+    h = _hash_mix(h, (uint32_t)cmd->rect.x | (uint64_t)(uint32_t)cmd->rect.y << 32);
+    h = _hash_mix(h, (uint32_t)cmd->rect.w | (uint64_t)(uint32_t)cmd->rect.h << 32);
+    h = _hash_mix(h, (uint32_t)clip.x | (uint64_t)(uint32_t)clip.y << 32);
+    h = _hash_mix(h, (uint32_t)clip.w | (uint64_t)(uint32_t)clip.h << 32);
+    switch(cmd->kind) {
+    case YUI_DRAW_RECT: {
+        union { float f; uint32_t u; } roundness = { .f = cmd->roundness };
+        h = _hash_mix(h, roundness.u);
+    } break;
+    case YUI_DRAW_RECT_OUTLINE:
+        h = _hash_mix(h, (uint32_t)cmd->border_width);
+        break;
+    case YUI_DRAW_TEXT:
+        h = _hash_mix(h, (uint64_t)(uintptr_t)cmd->text.font);
+        h = _hash_mix(h, (uint32_t)cmd->text.font_size);
+        h = _hash_str(h, cmd->text.str);
+        break;
+    default: break;
+    }
+    return h;
+}
+
+internal void _add_damage(yui_Damage *damage, yui_Rect rect)
+{
+    if(rect.w <= 0 || rect.h <= 0) return;
+    // Fold the rect into whatever it touches until nothing overlaps anymore
+    for(uint32_t i = 0; i < damage->count;) {
+        yui_Rect other = damage->rects[i];
+        yui_Rect grown = { other.x - 1, other.y - 1, other.w + 2, other.h + 2 };
+        if(_rects_overlap(grown, rect)) {
+            rect = _union_rect(rect, other);
+            damage->rects[i] = damage->rects[--damage->count];
+            i = 0;
+        } else {
+            ++i;
+        }
+    }
+    if(damage->count == YUI_DAMAGE_RECTS_CAP) {
+        uint32_t best = 0;
+        int64_t best_cost = INT64_MAX;
+        for(uint32_t i = 0; i < damage->count; ++i) {
+            int64_t cost = _rect_area(_union_rect(damage->rects[i], rect)) - _rect_area(damage->rects[i]);
+            if(cost < best_cost) { best = i; best_cost = cost; }
+        }
+        rect = _union_rect(damage->rects[best], rect);
+        damage->rects[best] = damage->rects[--damage->count];
+        _add_damage(damage, rect);
+        return;
+    }
+    damage->rects[damage->count++] = rect;
+}
+
+internal yui_DamageRecord *_reserve_damage_records(yui_Damage *damage, uint32_t which, uint32_t count)
+{
+    if(damage->cap_records[which] < count) {
+        yui_DamageRecord *records = YUI_REALLOC(damage->records[which], count*sizeof(*records));
+        assert(records != NULL && "Out of memory");
+        damage->records[which] = records;
+        damage->cap_records[which] = count;
+    }
+    return damage->records[which];
+}
+
+#define DAMAGE_SLOT_TOMBSTONE (UINT32_MAX - 1)
+
+internal uint32_t _find_damage_slot(yui_Damage *damage, const yui_DamageRecord *old, uint64_t hash)
+{
+    uint32_t slot = (uint32_t)hash & (damage->count_slots - 1);
+    for(;;) {
+        uint32_t index = damage->slots[slot];
+        if(index == UINT32_MAX) return slot;
+        if(index != DAMAGE_SLOT_TOMBSTONE && old[index].hash == hash) return slot;
+        slot = (slot + 1) & (damage->count_slots - 1);
+    }
+}
+
+// Adds the damage of the frames the back buffer lags behind by to that of this frame
+internal void _finish_damage(yui_Damage *damage, yui_Rect screen)
+{
+    damage->count_frames += 1;
+    // Keep the damage of the last few frames for back buffers that lag behind
+    for(uint32_t i = YUI_DAMAGE_HISTORY - 1; i > 0; --i)
+        damage->history[i] = damage->history[i - 1];
+    memcpy(damage->history[0].rects, damage->rects, sizeof(damage->rects));
+    damage->history[0].count = damage->count;
+    damage->history[0].full  = damage->full;
+    uint32_t age = MY_MIN(MY_MAX(damage->buffer_age, 1), YUI_DAMAGE_HISTORY);
+    if(damage->count_frames < age) damage->full = true;
+    for(uint32_t i = 1; i < age && !damage->full; ++i) {
+        if(damage->history[i].full) damage->full = true;
+        for(uint32_t j = 0; j < damage->history[i].count; ++j)
+            _add_damage(damage, damage->history[i].rects[j]);
+    }
+
+    int64_t area = 0;
+    for(uint32_t i = 0; i < damage->count; ++i) area += _rect_area(damage->rects[i]);
+    if(area*4 >= _rect_area(screen)*3) damage->full = true;
+    if(damage->full) {
+        damage->count = 1;
+        damage->rects[0] = screen;
+    }
+}
+
+// Every command is matched against an identical one from last frame. Unmatched commands
+// on either side, and matched ones that moved before something drawn earlier, damage the
+// area they cover.
+internal void _compute_damage(yui_Ctx *ctx, yui_Rect screen)
+{
+    yui_Damage *damage = &ctx->damage;
+    yui_DrawList *list = &ctx->draw_list;
+    uint32_t prev = damage->curr;
+    uint32_t curr = prev ^ 1;
+    uint32_t count_prev = damage->count_records[prev];
+    yui_DamageRecord *old = damage->records[prev];
+
+    uint32_t count_slots = damage->count_slots ? damage->count_slots : 64;
+    while(count_slots < count_prev*2) count_slots *= 2;
+    if(count_slots != damage->count_slots) {
+        YUI_FREE(damage->slots);
+        damage->slots = YUI_MALLOC(count_slots*sizeof(*damage->slots));
+        assert(damage->slots != NULL && "Out of memory");
+        damage->count_slots = count_slots;
+    }
+    for(uint32_t i = 0; i < count_slots; ++i) damage->slots[i] = UINT32_MAX;
+    // Build the chains back to front so every chain is in painter's order
+    for(uint32_t i = count_prev; i-- > 0;) {
+        uint32_t slot = _find_damage_slot(damage, old, old[i].hash);
+        old[i].next = damage->slots[slot];
+        damage->slots[slot] = i;
+    }
+
+    damage->count = 0;
+    damage->full = damage->count_frames == 0 || list->required > list->cap ||
+        memcmp(&screen, &damage->screen, sizeof(screen)) != 0;
+    damage->screen = screen;
+
+    yui_DamageRecord *records = _reserve_damage_records(damage, curr, list->count);
+    uint32_t count_records = 0;
+    uint32_t last_matched = 0;
+    uint32_t count_matched = 0;
+    yui_Rect clip = screen;
+    // A full frame still records its commands, so the next one only redraws what changes
+    for(uint32_t i = 0; i < list->count; ++i) {
+        const yui_DrawCommand *cmd = &list->items[i];
+        if(cmd->kind == YUI_DRAW_SCISSOR_PUSH) { clip = cmd->rect; continue; }
+        if(cmd->kind == YUI_DRAW_SCISSOR_POP)  { clip = cmd->restore ? cmd->rect : screen; continue; }
+        yui_DamageRecord *record = &records[count_records++];
+        record->hash = _hash_command(cmd, clip);
+        record->rect = _intersect_rect(cmd->rect, clip);
+        if(damage->full) continue;
+
+        uint32_t slot = _find_damage_slot(damage, old, record->hash);
+        uint32_t match = damage->slots[slot];
+        if(match >= DAMAGE_SLOT_TOMBSTONE) {
+            _add_damage(damage, record->rect);
+            continue;
+        }
+        // An emptied chain leaves a tombstone so probing for other hashes still works
+        damage->slots[slot] = old[match].next == UINT32_MAX ? DAMAGE_SLOT_TOMBSTONE : old[match].next;
+        old[match].hash = ~old[match].hash;
+        count_matched += 1;
+        if(count_matched > 1 && match < last_matched) _add_damage(damage, record->rect);
+        else last_matched = match;
+    }
+    for(uint32_t i = 0; i < count_prev && !damage->full; ++i) {
+        // Matched records had their hash flipped above
+        uint32_t slot = _find_damage_slot(damage, old, old[i].hash);
+        if(damage->slots[slot] < DAMAGE_SLOT_TOMBSTONE) _add_damage(damage, old[i].rect);
+    }
+    damage->count_records[curr] = count_records;
+    damage->curr = curr;
+    _finish_damage(damage, screen);
+}
+
+void yui_replay_damage(yui_Ctx *ctx, const yui_DrawCommand *commands, uint32_t count)
+{
+    yui_Damage *damage = &ctx->damage;
+    for(uint32_t d = 0; d < damage->count; ++d) {
+        yui_Rect area = damage->rects[d];
+        yui_Rect clip = area;
+        begin_scissor_mode(ctx, area);
+        if(damage->clear_color.a) draw_rect(ctx, area, damage->clear_color, 0);
+        for(uint32_t i = 0; i < count; ++i) {
+            const yui_DrawCommand *cmd = &commands[i];
+            switch(cmd->kind) {
+            case YUI_DRAW_SCISSOR_PUSH:
+                clip = _intersect_rect(cmd->rect, area);
+                begin_scissor_mode(ctx, clip);
+                break;
+            case YUI_DRAW_SCISSOR_POP:
+                clip = cmd->restore ? _intersect_rect(cmd->rect, area) : area;
+                begin_scissor_mode(ctx, clip);
+                break;
+            default:
+                if(_rects_overlap(cmd->rect, clip)) _execute_command(ctx, cmd);
+                break;
+            }
+        }
+        end_scissor_mode(ctx);
+    }
+}
+
+void yui_replay_layers(yui_Ctx *ctx, const yui_DrawLayer *layers, uint32_t count)
+{
+    for(uint32_t l = 0; l < count; ++l) {
+        const yui_DrawLayer *layer = &layers[l];
+        yui_Rect area = layer->clip;
+        if(!layer->clipped) area = (yui_Rect){ INT_MIN/2, INT_MIN/2, INT_MAX, INT_MAX };
+        yui_Rect clip = area;
+        if(layer->clipped) begin_scissor_mode(ctx, area);
+        for(uint32_t i = 0; i < layer->count; ++i) {
+            yui_DrawCommand cmd = layer->commands[i];
+            cmd.rect.x += layer->offset.x;
+            cmd.rect.y += layer->offset.y;
+            switch(cmd.kind) {
+            case YUI_DRAW_SCISSOR_PUSH:
+                clip = _intersect_rect(cmd.rect, area);
+                begin_scissor_mode(ctx, clip);
+                break;
+            case YUI_DRAW_SCISSOR_POP:
+                clip = cmd.restore ? _intersect_rect(cmd.rect, area) : area;
+                if(cmd.restore || layer->clipped) begin_scissor_mode(ctx, clip);
+                else end_scissor_mode(ctx);
+                break;
+            default:
+                if(_rects_overlap(cmd.rect, clip)) _execute_command(ctx, &cmd);
+                break;
+            }
+        }
+        if(layer->clipped) end_scissor_mode(ctx);
+    }
+}
+
+internal void _collect_hit_boxes(yui_Ctx *ctx, yui_HitIndex *index, yui_Box *box, yui_Rect clip)
+{
+    if(box != &ctx->root && _is_culled(ctx, box, clip)) return;
+    yui_Rect rect = _intersect_rect(box->layout.padding_box, clip);
+    if(index->count == index->cap) {
+        index->cap = index->cap ? index->cap*2 : 256;
+        GROW_ARRAY(index->boxes, index->cap);
+        GROW_ARRAY(index->rects, index->cap);
+        GROW_ARRAY(index->stamps, index->cap);
+    }
+    index->boxes[index->count] = box;
+    index->rects[index->count] = rect;
+    index->stamps[index->count] = 0;
+    index->count += 1;
+
+    yui_Rect child_clip = _child_clip(box, clip);
+    for(yui_Box *child = box->children.begin; child != NULL; child = child->next)
+        _collect_hit_boxes(ctx, index, child, child_clip);
+}
+
+// Cell range a rect covers, false when it misses the grid
+internal bool _hit_cells(const yui_HitIndex *index, int cell_size, yui_Rect rect, uint32_t *c0, uint32_t *r0, uint32_t *c1, uint32_t *r1)
+{
+    rect = _intersect_rect(rect, index->screen);
+    if(rect.w <= 0 || rect.h <= 0) return false;
+    *c0 = (uint32_t)((rect.x - index->screen.x)/cell_size);
+    *r0 = (uint32_t)((rect.y - index->screen.y)/cell_size);
+    *c1 = (uint32_t)((rect.x + rect.w - 1 - index->screen.x)/cell_size);
+    *r1 = (uint32_t)((rect.y + rect.h - 1 - index->screen.y)/cell_size);
+    return true;
+}
+
+internal void _build_hit_index(yui_Ctx *ctx)
+{
+    yui_HitIndex *index = &ctx->hit_index;
+    int cell_size = index->cell_size > 0 ? index->cell_size : YUI_HIT_CELL_SIZE;
+    index->frame  = ctx->frame;
+    index->screen = ctx->root.layout.padding_box;
+    index->count  = 0;
+    index->stamp  = 0;
+    index->count_large = 0;
+    _collect_hit_boxes(ctx, index, &ctx->root, index->screen);
+
+    index->cols = (uint32_t)MY_MAX((index->screen.w + cell_size - 1)/cell_size, 1);
+    index->rows = (uint32_t)MY_MAX((index->screen.h + cell_size - 1)/cell_size, 1);
+    uint32_t count_cells = index->cols*index->rows;
+    if(index->cells_cap < count_cells + 1) {
+        index->cells_cap = count_cells + 1;
+        GROW_ARRAY(index->cell_begin, index->cells_cap);
+    }
+    if(index->large_cap < index->cap) {
+        index->large_cap = index->cap;
+        GROW_ARRAY(index->large, index->large_cap);
+    }
+    for(uint32_t i = 0; i <= count_cells; ++i) index->cell_begin[i] = 0;
+
+    // Count, prefix sum, then fill back to front so every cell ends up in painter's order
+    uint32_t c0, r0, c1, r1;
+    for(uint32_t i = 0; i < index->count; ++i) {
+        if(!_hit_cells(index, cell_size, index->rects[i], &c0, &r0, &c1, &r1)) continue;
+        if((c1 - c0 + 1)*(r1 - r0 + 1) > YUI_HIT_LARGE_CELLS) {
+            index->large[index->count_large++] = i;
+            continue;
+        }
+        for(uint32_t r = r0; r <= r1; ++r)
+            for(uint32_t c = c0; c <= c1; ++c)
+                index->cell_begin[r*index->cols + c + 1] += 1;
+    }
+    for(uint32_t i = 0; i < count_cells; ++i) index->cell_begin[i + 1] += index->cell_begin[i];
+    uint32_t total = index->cell_begin[count_cells];
+    if(index->cell_items_cap < total) {
+        index->cell_items_cap = total;
+        GROW_ARRAY(index->cell_items, index->cell_items_cap);
+    }
+    uint32_t large = index->count_large;
+    for(uint32_t i = index->count; i-- > 0;) {
+        if(large > 0 && index->large[large - 1] == i) { large -= 1; continue; }
+        if(!_hit_cells(index, cell_size, index->rects[i], &c0, &r0, &c1, &r1)) continue;
+        for(uint32_t r = r0; r <= r1; ++r) {
+            for(uint32_t c = c0; c <= c1; ++c) {
+                uint32_t cell = r*index->cols + c;
+                index->cell_items[--index->cell_begin[cell + 1]] = i;
+            }
+        }
+    }
+    // Filling moved every cell's end down to its begin, which is now one slot to the right
+    for(uint32_t i = 0; i < count_cells; ++i) index->cell_begin[i] = index->cell_begin[i + 1];
+    index->cell_begin[count_cells] = total;
+}
+
+internal yui_HitIndex *_get_hit_index(yui_Ctx *ctx)
+{
+    if(ctx->hit_index.frame != ctx->frame) _build_hit_index(ctx);
+    return &ctx->hit_index;
+}
+
+internal yui_Box *_hit_test_index(yui_HitIndex *index, int cell_size, int x, int y)
+{
+    if(!POINT_IN_RECT(index->screen, x, y)) return NULL;
+    uint32_t c = (uint32_t)((x - index->screen.x)/cell_size);
+    uint32_t r = (uint32_t)((y - index->screen.y)/cell_size);
+    uint32_t cell = r*index->cols + c;
+    int64_t best = -1;
+    for(uint32_t i = index->cell_begin[cell + 1]; i-- > index->cell_begin[cell];) {
+        uint32_t item = index->cell_items[i];
+        if(POINT_IN_RECT(index->rects[item], x, y)) { best = item; break; }
+    }
+    for(uint32_t i = index->count_large; i-- > 0;) {
+        uint32_t item = index->large[i];
+        if((int64_t)item <= best) break;
+        if(POINT_IN_RECT(index->rects[item], x, y)) { best = item; break; }
+    }
+    return best < 0 ? NULL : index->boxes[best];
+}
+
+yui_Box *yui_hit_test_top(yui_Ctx *ctx, int x, int y)
+{
+    yui_HitIndex *index = _get_hit_index(ctx);
+    return _hit_test_index(index, index->cell_size > 0 ? index->cell_size : YUI_HIT_CELL_SIZE, x, y);
+}
+
+void yui_hit_test_points(yui_Ctx *ctx, const yui_Point *points, uint32_t count, yui_Box **results)
+{
+    yui_HitIndex *index = _get_hit_index(ctx);
+    int cell_size = index->cell_size > 0 ? index->cell_size : YUI_HIT_CELL_SIZE;
+    for(uint32_t i = 0; i < count; ++i)
+        results[i] = _hit_test_index(index, cell_size, points[i].x, points[i].y);
+}
+
+uint32_t yui_query_rect(yui_Ctx *ctx, yui_Rect rect, yui_Box **results, uint32_t cap)
+{
+    yui_HitIndex *index = _get_hit_index(ctx);
+    int cell_size = index->cell_size > 0 ? index->cell_size : YUI_HIT_CELL_SIZE;
+    uint32_t count = 0;
+    // Boxes sit in every cell they cover, stamps make sure each is reported once
+    index->stamp += 1;
+    if(index->stamp == 0) {
+        for(uint32_t i = 0; i < index->count; ++i) index->stamps[i] = 0;
+        index->stamp = 1;
+    }
+    uint32_t c0, r0, c1, r1;
+    if(_hit_cells(index, cell_size, rect, &c0, &r0, &c1, &r1)) {
+        for(uint32_t r = r0; r <= r1; ++r) {
+            for(uint32_t c = c0; c <= c1; ++c) {
+                uint32_t cell = r*index->cols + c;
+                for(uint32_t i = index->cell_begin[cell]; i < index->cell_begin[cell + 1]; ++i) {
+                    uint32_t item = index->cell_items[i];
+                    if(index->stamps[item] == index->stamp || !_rects_overlap(index->rects[item], rect)) continue;
+                    index->stamps[item] = index->stamp;
+                    if(count < cap) results[count] = index->boxes[item];
+                    count += 1;
+                }
+            }
+        }
+    }
+    for(uint32_t i = 0; i < index->count_large; ++i) {
+        uint32_t item = index->large[i];
+        if(!_rects_overlap(index->rects[item], rect)) continue;
+        if(count < cap) results[count] = index->boxes[item];
+        count += 1;
+    }
+    return count;
+}
+
+// Adds the time since `start` to `pass` and returns the current time
+internal uint64_t _end_pass(yui_Ctx *ctx, yui_Pass pass, uint64_t start)
+{
+    uint64_t end = YUI_CLOCK_NS();
+    ctx->stats.ns[pass] += end - start;
+    TRACE_PASS(ctx, pass_names[pass], start, end);
+    return end;
+}
+
+// The root's hash covers the configs, text and keys of the tree as it was built
+internal uint64_t _frame_hash(yui_Ctx *ctx)
+{
+    const yui_Box *root = &ctx->root;
+    uint64_t h = _hash_mix(ctx->scroll_hash, root->hash);
+    h = _hash_mix(h, (uint32_t)root->fixed_width | (uint64_t)(uint32_t)root->fixed_height << 32);
+    h = _hash_mix(h, (uint64_t)ctx->flat_layout | (uint64_t)ctx->render_in_layout << 1 | (uint64_t)ctx->draw_offscreen << 2 |
+            (uint64_t)ctx->cull_layout << 3 | (uint64_t)ctx->damage.enabled << 4 | (uint64_t)ctx->draw_list.sort_by_state << 5 |
+            (uint64_t)ctx->draw_list.cap << 32);
+    return _hash_mix(h, (uint64_t)(uintptr_t)ctx->draw_list.items);
+}
+
+internal void _clear_layouts(yui_Ctx *ctx)
+{
+    ctx->root.layout = (yui_BoxLayout){0};
+    uint32_t left = ctx->boxes.count;
+    for(yui_BoxChunk *chunk = ctx->boxes.first; left > 0; chunk = chunk->next) {
+        uint32_t count = MY_MIN(left, chunk->cap);
+        for(uint32_t i = 0; i < count; ++i) chunk->items[i].layout = (yui_BoxLayout){0};
+        left -= count;
+    }
+}
+
+// The slot of `key` in a yui_Changes table, or the empty one it would go into
+internal uint32_t _change_slot(const uint32_t *slots, uint32_t count_slots, const yui_ChangeNode *nodes, uint64_t key)
+{
+    uint32_t slot = (uint32_t)key & (count_slots - 1);
+    while(slots[slot] && nodes[slots[slot] - 1].key != key) slot = (slot + 1) & (count_slots - 1);
+    return slot;
+}
+
+// Pre-order, so every box finds its parent's key already there
+internal void _record_changes(yui_Changes *changes, const yui_Box *box, uint64_t parent)
+{
+    uint32_t index = 0;
+    for(const yui_Box *child = box->children.begin; child != NULL; child = child->next, ++index) {
+        uint64_t key = child->key ? child->key : _hash_mix(parent, index);
+        uint32_t slot = _change_slot(changes->slots, changes->count_slots, changes->nodes, key);
+        // Unkeyed boxes can hash to the key of another box, they move on to one that is free
+        while(key == 0 || changes->slots[slot]) {
+            key = _hash_mix(key, index + 1);
+            slot = _change_slot(changes->slots, changes->count_slots, changes->nodes, key);
+        }
+        uint32_t n = changes->count_nodes++;
+        changes->slots[slot] = n + 1;
+        changes->nodes[n] = (yui_ChangeNode){
+            .key = key, .parent = parent, .style = child->style->hash,
+            .text = child->text ? _hash_str(FNV_OFFSET, child->text) : 0,
+            .padding_box = child->layout.padding_box, .content_box = yui_content_box(child),
+            .index = index, .box = child,
+        };
+        _record_changes(changes, child, key);
+    }
+}
+
+internal void _push_change(yui_Changes *changes, const yui_ChangeNode *node, uint32_t flags)
+{
+    if(changes->count == changes->cap) {
+        changes->cap = changes->cap ? changes->cap*2 : 64;
+        GROW_ARRAY(changes->items, changes->cap);
+    }
+    changes->items[changes->count++] = (yui_Change){
+        .flags = flags, .index = node->index, .key = node->key, .parent = node->parent,
+        .box = flags & YUI_CHANGE_REMOVED ? NULL : node->box,
+    };
+}
+
+// Compares the frame with the last one that had a change log. Matched nodes of that frame
+// are flagged with UINT32_MAX, whatever is left was removed.
+internal void _compute_changes(yui_Ctx *ctx)
+{
+    yui_Changes *changes = &ctx->changes;
+    yui_ChangeNode *nodes = changes->prev;
+    uint32_t cap_nodes = changes->cap_prev;
+    uint32_t *slots = changes->prev_slots;
+    uint32_t count_slots = changes->count_prev_slots;
+    changes->prev = changes->nodes;
+    changes->count_prev = changes->frame ? changes->count_nodes : 0;
+    changes->cap_prev = changes->cap_nodes;
+    changes->prev_slots = changes->slots;
+    changes->count_prev_slots = changes->count_slots;
+    changes->nodes = nodes;
+    changes->cap_nodes = cap_nodes;
+    changes->slots = slots;
+    changes->count_slots = count_slots;
+
+    uint32_t count = ctx->boxes.count;
+    if(changes->cap_nodes < count) {
+        changes->cap_nodes = MY_MAX(count, changes->cap_nodes*2);
+        GROW_ARRAY(changes->nodes, changes->cap_nodes);
+    }
+    if(changes->count_slots < count*2 || changes->count_slots == 0) {
+        uint32_t count_slots = changes->count_slots ? changes->count_slots : 256;
+        while(count_slots < count*2) count_slots *= 2;
+        YUI_FREE(changes->slots);
+        changes->slots = YUI_MALLOC(count_slots*sizeof(*changes->slots));
+        assert(changes->slots != NULL && "Out of memory");
+        changes->count_slots = count_slots;
+    }
+    memset(changes->slots, 0, changes->count_slots*sizeof(*changes->slots));
+    changes->count_nodes = 0;
+    _record_changes(changes, &ctx->root, 0);
+
+    for(uint32_t i = 0; i < changes->count_nodes; ++i) {
+        yui_ChangeNode *node = &changes->nodes[i];
+        uint32_t slot = changes->count_prev ? _change_slot(changes->prev_slots, changes->count_prev_slots, changes->prev, node->key) : 0;
+        if(changes->count_prev == 0 || changes->prev_slots[slot] == 0) {
+            node->flags = YUI_CHANGE_INSERTED;
+            continue;
+        }
+        yui_ChangeNode *prev = &changes->prev[changes->prev_slots[slot] - 1];
+        node->flags = 0;
+        if(prev->parent != node->parent || prev->index != node->index) node->flags |= YUI_CHANGE_MOVED;
+        if(prev->style != node->style) node->flags |= YUI_CHANGE_RESTYLED;
+        if(memcmp(&prev->padding_box, &node->padding_box, sizeof(node->padding_box)) != 0 ||
+                memcmp(&prev->content_box, &node->content_box, sizeof(node->content_box)) != 0)
+            node->flags |= YUI_CHANGE_RELAID_OUT;
+        if(prev->text != node->text) node->flags |= YUI_CHANGE_TEXT;
+        prev->flags = UINT32_MAX;
+    }
+
+    changes->count = 0;
+    for(uint32_t i = 0; i < changes->count_prev; ++i)
+        if(changes->prev[i].flags != UINT32_MAX) _push_change(changes, &changes->prev[i], YUI_CHANGE_REMOVED);
+    for(uint32_t i = 0; i < changes->count_nodes; ++i)
+        if(changes->nodes[i].flags) _push_change(changes, &changes->nodes[i], changes->nodes[i].flags);
+    changes->frame = ctx->frame;
+}
+
+// The boxes hold last frame's layout and the draw list its commands, what is left is to
+// keep the retained state, damage and hit index current. Commands pointing at text that
+// moved are rendered again, the strings of last frame may be gone.
+internal uint64_t _reuse_frame(yui_Ctx *ctx, uint64_t t)
+{
+    // The flat engine leaves the retained layouts behind
+    if(ctx->retained_frame + 1 == ctx->frame) ctx->retained_frame = ctx->frame;
+    if(ctx->draw_list.items && ctx->text_pointers != ctx->drawn_pointers) {
+        // Boxes start out with their unbroken lines, the line cache has the frame's breaks
+        for(uint32_t i = 0; i < ctx->count_wrapped; ++i) {
+            yui_Box *box = ctx->wrap_guesses[i].box;
+            box->lines = _wrap_lines(ctx, box->lines, box->text, yui_content_box(box).w);
+        }
+        ctx->draw_list.count = 0;
+        ctx->draw_list.required = 0;
+        _render(ctx, &ctx->root, ctx->root.layout.padding_box, false);
+        t = _end_pass(ctx, YUI_PASS_RENDER, t);
+        if(ctx->draw_list.sort_by_state) {
+            _sort_draw_list(&ctx->draw_list);
+            t = _end_pass(ctx, YUI_PASS_SORT, t);
+        }
+        ctx->drawn_pointers = ctx->text_pointers;
+        ctx->drawn_boxes = ctx->stats.count_drawn_boxes;
+    }
+    ctx->stats.count_drawn_boxes = ctx->drawn_boxes;
+    ctx->stats.count_culled_boxes = ctx->stats.count_boxes - ctx->stats.count_drawn_boxes;
+    if(ctx->draw_list.items && ctx->damage.enabled) {
+        ctx->damage.count = 0;
+        ctx->damage.full = false;
+        _finish_damage(&ctx->damage, ctx->root.layout.padding_box);
+        t = _end_pass(ctx, YUI_PASS_DAMAGE, t);
+    }
+    if(ctx->hit_index.frame + 1 == ctx->frame) {
+        ctx->hit_index.frame = ctx->frame;
+    } else if(ctx->hit_index.enabled) {
+        _build_hit_index(ctx);
+        t = _end_pass(ctx, YUI_PASS_HIT_INDEX, t);
+    }
+    if(ctx->changes.enabled && ctx->changes.frame + 1 == ctx->frame) {
+        ctx->changes.count = 0;
+        ctx->changes.frame = ctx->frame;
+    } else if(ctx->changes.enabled) {
+        _compute_changes(ctx);
+        t = _end_pass(ctx, YUI_PASS_CHANGES, t);
+    }
+    return t;
+}
+
+bool yui_end_frame(yui_Ctx *ctx)
+{
+    yui_Box *root = &ctx->root;
+    uint64_t begin = YUI_CLOCK_NS();
+    uint64_t t = begin;
+    ctx->stats.count_boxes = ctx->boxes.count + 1;
+    uint64_t frame_hash = _frame_hash(ctx);
+    // A list that overflowed has to be drawn again once it has grown
+    ctx->stats.unchanged = ctx->layout_frame != 0 && ctx->ended_frame + 1 == ctx->frame &&
+        frame_hash == ctx->frame_hash && ctx->draw_list.required <= ctx->draw_list.cap;
+    ctx->frame_hash = frame_hash;
+    ctx->ended_frame = ctx->frame;
+    if(ctx->stats.unchanged && ctx->skip_unchanged) {
+        t = _reuse_frame(ctx, t);
+        ctx->stats.ns_end_frame = t - begin;
+        TRACE_PASS(ctx, "end_frame", begin, t);
+        return false;
+    }
+    if(ctx->skip_unchanged) _clear_layouts(ctx);
+    ctx->draw_list.count = 0;
+    ctx->draw_list.required = 0;
+    // Widths never depend on heights, so a second layout breaks every line the same way
+    // and only has to place the new heights
+    ctx->relayout = false;
+    if(ctx->flat.active) {
+        do {
+            if(ctx->relayout) ctx->stats.count_relayouts += 1;
+            ctx->relayout = false;
+            _compute_flat_fit(ctx);
+            t = _end_pass(ctx, YUI_PASS_FIT, t);
+            _compute_flat_grow_and_pos(ctx);
+            for(uint32_t i = 0; ctx->count_wrapped && i < ctx->flat.count; ++i)
+                if(ctx->flat.boxes[i]->lines) _wrap_text_box(ctx, ctx->flat.boxes[i]);
+            t = _end_pass(ctx, YUI_PASS_GROW_AND_POS, t);
+        } while(ctx->relayout && ctx->stats.count_relayouts == 0);
+        _render(ctx, root, root->layout.padding_box, false);
+        t = _end_pass(ctx, YUI_PASS_RENDER, t);
+    } else {
+        root->count_subtree = ctx->boxes.count + 1;
+        _begin_parallel(ctx);
+        _begin_kept(ctx);
+        // Whatever got drawn would be thrown away by a second layout, and tasks can't draw
+        bool render_in_layout = ctx->render_in_layout && ctx->count_wrapped == 0 && !ctx->parallel.active;
+        do {
+            if(ctx->relayout) ctx->stats.count_relayouts += 1;
+            ctx->relayout = false;
+            _layout_fit(ctx);
+            t = _end_pass(ctx, YUI_PASS_FIT, t);
+            _layout_grow_and_pos(ctx, render_in_layout ? LAYOUT_RENDER : 0);
+            ctx->retained_frame = ctx->frame;
+            t = _end_pass(ctx, YUI_PASS_GROW_AND_POS, t);
+        } while(ctx->relayout && ctx->stats.count_relayouts == 0);
+        _end_kept(ctx);
+        if(!render_in_layout) {
+            _render(ctx, root, root->layout.padding_box, false);
+            t = _end_pass(ctx, YUI_PASS_RENDER, t);
+        }
+    }
+    ctx->stats.count_culled_boxes = ctx->stats.count_boxes - ctx->stats.count_drawn_boxes;
+    ctx->drawn_pointers = ctx->text_pointers;
+    ctx->drawn_boxes = ctx->stats.count_drawn_boxes;
+    for(uint32_t i = 0; i < ctx->count_wrapped; ++i)
+        ctx->wrap_guesses[i].height = yui_content_box(ctx->wrap_guesses[i].box).h;
+    ctx->count_wrap_guesses = ctx->count_wrapped;
+    if(ctx->draw_list.items && ctx->damage.enabled) {
+        _compute_damage(ctx, root->layout.padding_box);
+        t = _end_pass(ctx, YUI_PASS_DAMAGE, t);
+    }
+    if(ctx->draw_list.items && ctx->draw_list.sort_by_state) {
+        _sort_draw_list(&ctx->draw_list);
+        t = _end_pass(ctx, YUI_PASS_SORT, t);
+    }
+    if(ctx->hit_index.enabled) {
+        _build_hit_index(ctx);
+        t = _end_pass(ctx, YUI_PASS_HIT_INDEX, t);
+    }
+    if(ctx->changes.enabled) {
+        _compute_changes(ctx);
+        t = _end_pass(ctx, YUI_PASS_CHANGES, t);
+    }
+    ctx->layout_frame = ctx->frame;
+    ctx->stats.ns_end_frame = t - begin;
+    TRACE_PASS(ctx, "end_frame", begin, t);
+    return !ctx->stats.unchanged;
 }
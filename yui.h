@@ -3,10 +3,15 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
 
+// HIDDEN and SCROLL clip the children to the padding box. A GROW box that scrolls on an
+// axis does not grow with its content on that axis, it only takes the free space.
 typedef enum {
-    YUI_OVERFLOW_SCROLL = 0,
+    YUI_OVERFLOW_VISIBLE = 0,
     YUI_OVERFLOW_HIDDEN,
+    YUI_OVERFLOW_SCROLL,
 } yui_OverflowMode;
 
 typedef enum {
@@ -23,22 +28,24 @@ typedef enum {
 typedef struct { uint8_t r, g, b, a; } yui_Color;
 typedef struct { int     x, y, w, h; } yui_Rect;
 typedef struct { int     l, t, r, b; } yui_Bound;
+typedef struct { int     x, y;       } yui_Point;
 #define YUI_COLOR_BLACK (yui_Color) { .a=0xFF }
 #define YUI_COLOR_WHITE (yui_Color) { .r=0xFF, .g=0xFF, .b=0xFF, .a=0xFF }
 
+// With `wrap` the text breaks into lines at spaces to fit the width its box gets from grow
+// sizing, '\n' always starts a new line. A word wider than the box gets a line of its own.
 typedef struct {
     void *font;
     int font_size;
     yui_Color color;
+    bool wrap;
 } yui_TextConfig;
 
 typedef struct {
-    // TODO
     struct {
         yui_OverflowMode x_axis;
         yui_OverflowMode y_axis;
     } overflow;
-    // END of TODO
     struct {
         yui_BoxSizing x_axis;
         yui_BoxSizing y_axis;
@@ -50,27 +57,49 @@ typedef struct {
     yui_Bound padding;
     yui_Bound margin;
     yui_Color background_color;
+    float roundness;
+    int border_width;
+    yui_Color border_color;
     yui_TextConfig text;
 } yui_BoxConfig;
 
+// An interned config, boxes with the same config point at the same style. Layout reads the
+// sums, per axis with x first, instead of adding up the margins and paddings of every box.
+typedef struct {
+    yui_BoxConfig config;
+    uint64_t hash;      // of config
+    int lead_margin[2];
+    int lead[2];        // margin + padding before the content
+    int padding[2];     // both sides
+    int margin[2];      // both sides
+} yui_Style;
+
+typedef uint32_t yui_StyleId; // from yui_style_intern, 0 is none
+
+// Only the padding box is stored, the content and margin boxes follow from the style's
+// paddings and margins, see yui_content_box and yui_margin_box
 typedef struct {
     yui_Rect padding_box;
-    yui_Rect margin_box;
-    yui_Rect content_box;
-    uint32_t cursor_x;
-    uint32_t cursor_y;
-
-    uint32_t count_grow_box_children;
-    uint32_t count_children_with_grow_box_on_x_axis;
-    uint32_t count_children_with_grow_box_on_y_axis;
-    int filled_width;
-    int filled_height;
 } yui_BoxLayout;
 
+// Where the grow pass places the next child of a box, the size of its content, how much of
+// it the children fill and how many of them grow, per axis with x first. It only lives while
+// the pass walks them.
+typedef struct {
+    int cursor[2];
+    int content[2];
+    int filled[2];
+    uint32_t count_grow[2];
+} yui_LayoutCursor;
+
 typedef struct yui_Box yui_Box;
+// Fields are ordered so nothing is padded. What is kept across frames for a keyed box is in
+// its yui_Retained entry, everything the layout passes read on every box stays here.
 struct yui_Box {
     uint32_t id;
     uint32_t level;
+    uint64_t hash;     // config, text and children of the whole subtree
+    uint64_t key;      // given to yui_open_box_keyed or derived from the nearest keyed box above, else 0
     yui_Box *next;
     yui_Box *parent;
     struct {
@@ -78,43 +107,787 @@ struct yui_Box {
         yui_Box *end;
         uint32_t count;
     } children;
+    const yui_Style *style;
     const char *text;
+    uint32_t retained; // index into yui_Ctx.retained for boxes opened with a key, 0 otherwise
+    uint32_t lines;    // entry in yui_Ctx.line_cache for wrapped text, 0 otherwise
+    uint32_t count_subtree; // boxes in the subtree, itself included
+    uint32_t task;     // 1 + index into yui_Ctx.parallel.items when a task lays out the children
+    yui_Point scroll;  // offset of the children, only set on axes that scroll
+    int fixed_width;   // the style's, except for text boxes and the spacers of virtual lists
+    int fixed_height;
+    bool clean;        // keyed box whose subtree and scroll offsets are unchanged since last frame
+    bool wrap_pending; // wrapped text reached by a parallel layout, broken into lines after it
 
     yui_BoxLayout layout;
-    yui_BoxConfig config;
 };
 
+typedef enum {
+    YUI_DRAW_RECT = 0,
+    YUI_DRAW_RECT_OUTLINE,
+    YUI_DRAW_TEXT,
+    YUI_DRAW_SCISSOR_PUSH,
+    YUI_DRAW_SCISSOR_POP,
+} yui_DrawKind;
+
+typedef struct {
+    yui_DrawKind kind;
+    yui_Color color;
+    // For YUI_DRAW_SCISSOR_POP this is the scissor to go back to when `restore` is set
+    yui_Rect rect;
+    union {
+        float roundness;
+        int border_width;
+        bool restore;
+        struct {
+            void *font;
+            const char *str;
+            int font_size;
+        } text;
+    };
+} yui_DrawCommand;
+
+// When `items` is set yui_end_frame writes the frame into it instead of calling the
+// draw callbacks. `required` is the number of commands the frame needed, anything
+// past `cap` is dropped. With `sort_by_state` commands that share a font or a rect
+// kind are moved next to each other as long as no overlapping command is reordered.
+typedef struct {
+    yui_DrawCommand *items;
+    uint32_t count;
+    uint32_t cap;
+    uint32_t required;
+    bool sort_by_state;
+
+    yui_DrawCommand *scratch;
+    uint64_t *keys;
+    uint32_t scratch_cap;
+} yui_DrawList;
+
+// Compares the frame's draw commands against the previous frame and collects the
+// screen areas that changed. Needs ctx->draw_list to have a buffer. `buffer_age`
+// is how many frames old the backend's back buffer is when drawing starts, 1 when
+// it keeps the last frame, 2 for a double buffered swap chain.
+#define YUI_DAMAGE_RECTS_CAP 8
+#define YUI_DAMAGE_HISTORY 4
+typedef struct {
+    uint64_t hash;
+    yui_Rect rect;
+    uint32_t next;
+} yui_DamageRecord;
+
+typedef struct {
+    bool enabled;
+    uint32_t buffer_age;
+    yui_Color clear_color; // damaged areas are filled with this first unless it is transparent
+
+    bool full; // the whole screen has to be redrawn
+    yui_Rect rects[YUI_DAMAGE_RECTS_CAP];
+    uint32_t count;
+
+    yui_Rect screen;
+    uint32_t count_frames;
+    struct {
+        yui_Rect rects[YUI_DAMAGE_RECTS_CAP];
+        uint32_t count;
+        bool full;
+    } history[YUI_DAMAGE_HISTORY];
+
+    yui_DamageRecord *records[2];
+    uint32_t count_records[2];
+    uint32_t cap_records[2];
+    uint32_t curr;
+    uint32_t *slots;
+    uint32_t count_slots;
+} yui_Damage;
+
+// Metrics of a font given to yui_register_font, distances in 1/64 pixel for text of `size`
+// pixels. yui measures the text of a registered font itself, scaled to the font size of the
+// text, and puts its lines ascent + descent + line_gap apart instead of font_size.
+typedef struct {
+    uint32_t codepoint;
+    int32_t advance;
+} yui_GlyphAdvance;
+
+typedef struct {
+    uint32_t left;
+    uint32_t right;
+    int32_t adjust;          // added to the advance of `left` when `right` follows it
+} yui_KerningPair;
+
+typedef struct {
+    int size;
+    int32_t ascent;
+    int32_t descent;         // below the baseline, positive
+    int32_t line_gap;
+    int32_t spacing;         // between glyphs, the same at every size like raylib's
+    int32_t default_advance; // of codepoints missing from `advances`
+    const yui_GlyphAdvance *advances;
+    uint32_t count_advances;
+    const yui_KerningPair *kerning;
+    uint32_t count_kerning;
+} yui_FontMetrics;
+
+typedef struct {
+    void *font;
+    yui_FontMetrics metrics;    // pointing at the copies below
+    int32_t ascii[128];
+    yui_GlyphAdvance *advances; // sorted by codepoint
+    yui_KerningPair *kerning;   // sorted by left, then right
+    uint8_t kerned[16];         // ASCII codepoints some pair starts with
+} yui_Font;
+
+typedef struct {
+    yui_Font *items;
+    uint32_t count;
+    uint32_t cap;
+} yui_FontTable;
+
+// LRU cache in front of config.measure_text. Entries are keyed by font, font size,
+// the string's length and a 64 bit hash of its content, and keep a copy of the string to
+// rule out collisions. `cap` is fixed on first use, 0 means YUI_TEXT_CACHE_CAP.
+#define YUI_TEXT_CACHE_CAP 1024
+typedef struct {
+    uint64_t hash;
+    void *font;
+    int font_size;
+    uint32_t length;
+    int width;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t bucket_next;
+    char *text;          // kept when the entry is reused
+    uint32_t cap_text;
+} yui_TextCacheEntry;
+
+typedef struct {
+    bool disabled;
+    uint32_t cap;
+    yui_TextCacheEntry *items;
+    uint32_t count;
+    uint32_t *buckets;
+    uint32_t count_buckets;
+    uint32_t head; // most recently used
+    uint32_t tail; // least recently used
+    uint64_t hits;
+    uint64_t misses;
+} yui_TextCache;
+
+// Line breaks of wrapped text boxes keyed by string, font, font size and width. Word widths
+// are measured once per string and shared by every width it is wrapped at, so a resize only
+// re-wraps. An entry used during a frame is not evicted until the next one. `cap` is fixed on
+// first use, 0 means YUI_LINE_CACHE_CAP, and grows when a frame uses every entry.
+#define YUI_LINE_CACHE_CAP 256
+typedef struct {
+    uint64_t hash;       // string, font and font size
+    void *font;
+    int font_size;
+    uint32_t length;
+    int width;           // wrapped at, INT_MAX for only the breaks at '\n'
+    int natural_width;   // widest line when only '\n' breaks
+    uint32_t used_frame; // last frame its lines were handed to a box
+    uint32_t seen_frame; // last frame it was looked up at all
+    char *text;          // copy of the string with 0 at the end of every line
+    char *source;        // copy of the string as given, compared on a lookup
+    uint32_t *words;     // offsets into `text`
+    int *word_widths;
+    uint32_t count_words;
+    uint32_t *lines;     // offsets into `text`
+    uint32_t count_lines;
+    uint32_t cap_bytes;
+    uint32_t bucket_next;
+} yui_LineCacheEntry;
+
+typedef struct {
+    uint32_t cap;
+    yui_LineCacheEntry *items; // items[0] is unused so that 0 can mean "none"
+    uint32_t count;
+    uint32_t *buckets;
+    uint32_t count_buckets;
+    uint32_t hand;             // next eviction candidate
+    const char **scratch;      // words handed to measure_texts
+    uint32_t scratch_cap;
+} yui_LineCache;
+
+// Uniform grid over the visible part of every box's padding_box. Index i is the i-th box
+// in painter's order so the topmost box at a point is the largest index containing it.
+// Boxes spanning more than YUI_HIT_LARGE_CELLS cells are kept in a separate list.
+#define YUI_HIT_CELL_SIZE 64
+#define YUI_HIT_LARGE_CELLS 16
+typedef struct {
+    bool enabled;  // build in yui_end_frame, otherwise on the first query of a frame
+    int cell_size; // 0 means YUI_HIT_CELL_SIZE
+
+    uint32_t frame;
+    yui_Rect screen;
+    yui_Box **boxes;
+    yui_Rect *rects;
+    uint32_t *stamps;
+    uint32_t stamp;
+    uint32_t count;
+    uint32_t cap;
+    uint32_t cols;
+    uint32_t rows;
+    uint32_t *cell_begin;
+    uint32_t cells_cap;
+    uint32_t *cell_items;
+    uint32_t cell_items_cap;
+    uint32_t *large;
+    uint32_t count_large;
+    uint32_t large_cap;
+} yui_HitIndex;
+
+// Pointer state given with yui_set_pointer, resolved in yui_begin_frame against the layout of
+// the frame before. Boxes are told apart by key, unkeyed boxes by their id, which only holds
+// while the boxes opened before them are the same.
+typedef struct {
+    bool enabled;      // set by the first yui_set_pointer
+    yui_Point pointer;
+    bool down;
+    bool was_down;     // as of the last yui_begin_frame
+    bool pressed;      // went down since the frame before
+    bool released;     // went up since the frame before
+    uint64_t *hovered; // the topmost box at the pointer and its ancestors, root excluded
+    uint32_t count_hovered;
+    uint32_t cap_hovered;
+    uint64_t *active;  // what `hovered` was when the pointer went down, until it goes up
+    uint32_t count_active;
+    uint32_t cap_active;
+} yui_Input;
+
+typedef struct {
+    bool hovered; // under the pointer, not covered by another box
+    bool active;  // the pointer went down over it and is still down
+    bool pressed; // the pointer went down over it in this frame
+    bool clicked; // the pointer went up over it in this frame after going down over it
+} yui_Interaction;
+
+// What yui_end_frame changed since the frame before, see yui_Changes
+typedef enum {
+    YUI_CHANGE_INSERTED   = 1 << 0,
+    YUI_CHANGE_REMOVED    = 1 << 1,
+    YUI_CHANGE_MOVED      = 1 << 2, // to another parent or place among its siblings
+    YUI_CHANGE_RESTYLED   = 1 << 3,
+    YUI_CHANGE_RELAID_OUT = 1 << 4, // padding or content box
+    YUI_CHANGE_TEXT       = 1 << 5,
+} yui_ChangeFlags;
+
+typedef struct {
+    uint32_t flags;
+    uint32_t index;     // among the siblings
+    uint64_t key;
+    uint64_t parent;    // key of the parent, 0 for the children of the root
+    const yui_Box *box; // NULL for removed boxes, valid until the next yui_begin_frame
+} yui_Change;
+
+// One box of the frame as yui_Changes compares it with the next frame
+typedef struct {
+    uint64_t key;
+    uint64_t parent;
+    uint64_t style;
+    uint64_t text;      // hash of the text, 0 without
+    yui_Rect padding_box;
+    yui_Rect content_box;
+    uint32_t index;
+    uint32_t flags;     // its yui_ChangeFlags, UINT32_MAX once the next frame has it too
+    const yui_Box *box;
+} yui_ChangeNode;
+
+// Change log written by yui_end_frame when `enabled` is set, so a remote view or an
+// accessibility tree can follow the UI without walking it. Boxes are matched by their key,
+// unkeyed boxes under their parent's by their place among its siblings. Removed boxes come
+// first, in last frame's order, then the changed ones in the order they were opened, parents
+// before their children. A frame is compared with the last one that had a log, so the
+// first one inserts every box.
+typedef struct {
+    bool enabled;
+    yui_Change *items;
+    uint32_t count;
+    uint32_t cap;
+
+    uint32_t frame;         // `nodes` holds this frame, 0 for none
+    yui_ChangeNode *nodes;
+    uint32_t count_nodes;
+    uint32_t cap_nodes;
+    yui_ChangeNode *prev;   // the frame before
+    uint32_t count_prev;
+    uint32_t cap_prev;
+    uint32_t *slots;        // open addressing table of 1 + indices into nodes
+    uint32_t count_slots;
+    uint32_t *prev_slots;
+    uint32_t count_prev_slots;
+} yui_Changes;
+
+// Passes of yui_end_frame, in the order they run. When yui_Ctx.render_in_layout is set
+// rendering is counted in YUI_PASS_GROW_AND_POS.
+typedef enum {
+    YUI_PASS_FIT = 0,
+    YUI_PASS_GROW_AND_POS,
+    YUI_PASS_RENDER,
+    YUI_PASS_DAMAGE,
+    YUI_PASS_SORT,
+    YUI_PASS_HIT_INDEX,
+    YUI_PASS_CHANGES,
+    YUI_PASS_COUNT,
+} yui_Pass;
+
+// Reset by yui_begin_frame and filled in until yui_end_frame returns. Timings use
+// YUI_CLOCK_NS, which can be defined when building yui.c to use another clock.
+typedef struct {
+    uint32_t count_boxes;           // including the root
+    uint32_t max_depth;
+    uint32_t count_measure_text;    // measurements asked for, cache hits included
+    uint32_t count_text_cache_hits;
+    uint32_t count_wraps;           // line breaks computed rather than found in the line cache
+    uint32_t count_relayouts;       // layouts run again because wrapped text changed height
+    uint32_t count_draw_commands;   // issued to the callbacks or recorded, dropped ones included
+    uint32_t count_drawn_boxes;
+    uint32_t count_culled_boxes;    // skipped with a subtree outside the clip rect
+    uint32_t count_tasks;           // handed to config.parallel_for, over all layout passes
+    bool unchanged;                 // same tree as last frame, see yui_end_frame
+    uint64_t ns[YUI_PASS_COUNT];
+    uint64_t ns_end_frame;
+} yui_FrameStats;
+
+// Only called when yui.c is built with YUI_TRACE. Passes come as complete events ('X')
+// when they end, boxes as instant events ('i') when they are rendered.
+typedef struct {
+    const char *name;
+    char phase;
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+    const yui_Box *box; // set for box events
+} yui_TraceEvent;
+
 typedef int  (*yui_MeasureTextPfn)(void *font, const char *text, int font_size);
+typedef void (*yui_MeasureTextsPfn)(void *font, int font_size, const char *const *texts, uint32_t count, int *widths);
 typedef void (*yui_DrawTextPfn)(void *font, const char *text, int font_size, int x, int y, yui_Color tint);
 typedef void (*yui_DrawRectPfn)(yui_Rect rect, yui_Color color, float roundness);
 typedef void (*yui_DrawRectOutlinePfn)(yui_Rect rect, yui_Color color, int border_width);
 typedef void (*yui_BeginScissorModePfn)(yui_Rect rect);
 typedef void (*yui_EndScissorModePfn)(void);
+typedef void (*yui_TracePfn)(void *user, const yui_TraceEvent *event);
+typedef void (*yui_TaskPfn)(void *data, uint32_t index);
+// Runs task(data, i) for every i in [0, count), in any order and on any threads, and returns
+// once all of them are done. yui_pool.h has one.
+typedef void (*yui_ParallelForPfn)(void *user, yui_TaskPfn task, void *data, uint32_t count);
+
+// Boxes are handed out from a list of chunks that never move, so the `next`/`parent`
+// pointers stay valid for the whole frame. Chunks are kept across frames and the
+// arena is rewound in yui_begin_frame, so a pre-sized arena never allocates.
+#define YUI_BOX_CHUNK_CAP 256
+typedef struct yui_BoxChunk yui_BoxChunk;
+struct yui_BoxChunk {
+    yui_BoxChunk *next;
+    yui_Box *items;
+    uint32_t cap;
+    bool owned;
+};
+
+typedef struct {
+    yui_BoxChunk *first;
+    yui_BoxChunk *last;
+    yui_BoxChunk *curr;
+    uint32_t curr_count;
+    uint32_t chunk_cap;  // boxes per allocated chunk, 0 means YUI_BOX_CHUNK_CAP
+    uint32_t count;      // boxes handed out this frame
+    uint32_t capacity;   // boxes available across all chunks
+    uint32_t high_water; // largest `count` seen so far
+} yui_BoxArena;
+
+// Strings formatted during a frame, they stay valid until the next yui_begin_frame rewinds
+// the chunks. A string longer than `chunk_cap` gets a chunk of its own size. `chunk_cap` 0
+// means YUI_STRING_CHUNK_CAP. An unchanged frame formats the same strings into the same
+// places, so the draw list yui_end_frame keeps for it still points at live text.
+#define YUI_STRING_CHUNK_CAP 4096
+typedef struct yui_StringChunk yui_StringChunk;
+struct yui_StringChunk {
+    yui_StringChunk *next;
+    uint32_t cap;
+    char data[];
+};
+
+#define YUI_STYLE_CHUNK_CAP 64
+typedef struct yui_StyleChunk yui_StyleChunk;
+struct yui_StyleChunk {
+    yui_StyleChunk *next;
+    uint32_t cap;
+    yui_Style items[];
+};
+
+// Styles live in chunks so they stay in place while the table grows
+typedef struct {
+    yui_StyleChunk *first;
+    yui_StyleChunk *curr;
+    uint32_t used;       // styles of `curr` handed out
+    yui_Style **items;   // items[0] is unused so that 0 can mean "none"
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *slots;     // open addressing table of indices into items
+    uint32_t count_slots;
+} yui_StyleTable;
+
+typedef struct {
+    yui_StringChunk *first;
+    yui_StringChunk *curr;
+    uint32_t used;       // bytes of `curr` handed out
+    uint32_t chunk_cap;
+} yui_StringArena;
+
+// Per-key state kept across frames, only boxes opened with a key have an entry. An unchanged
+// subtree takes its fit size from here without visiting its children, and when the grow
+// pass gives it the size and placement it had last frame its layout is last frame's from
+// yui_KeptLayouts, moved to where it is now.
+typedef struct {
+    uint64_t key;
+    uint64_t hash;
+    uint32_t seen_frame;
+    uint32_t placed_frame; // last frame the grow pass reached the box, culled subtrees fall behind
+    uint32_t id;       // of the box this frame and the frame before
+    uint32_t prev_id;
+    uint32_t placed;   // the axes the grow pass positioned the box on
+    yui_Point scroll;
+    yui_Point view;    // content box size of a scrolling box last frame
+    yui_Point fit;     // padding box size after fit sizing
+} yui_Retained;
+
+typedef struct {
+    yui_Retained *items; // items[0] is unused so that 0 can mean "none"
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *slots;     // open addressing table of indices into items
+    uint32_t count_slots;
+    uint32_t live;       // entries seen during the current frame
+} yui_RetainedTable;
+
+// Padding boxes the tree engine laid out by box id, for the last frame and the current one.
+// Only written in frames with keyed boxes, which are the only ones that can read them back.
+typedef struct {
+    yui_Rect *prev;
+    yui_Rect *curr;
+    uint32_t count_prev;
+    uint32_t cap;
+    bool active;       // `curr` is written this frame
+} yui_KeptLayouts;
+
+// How the tree engine splits a frame for config.parallel_for. Boxes with more than
+// yui_Ctx.parallel_threshold boxes in their subtree that changed since last frame are laid
+// out on the calling thread, every other child of theirs is an item. Consecutive items are
+// grouped into tasks of about parallel_threshold boxes. Items only write to their own subtree
+// and its retained entries, so the result is the same as laying the frame out serially.
+#define YUI_PARALLEL_THRESHOLD 1024
+typedef struct {
+    yui_Box *box;
+    uint32_t flags;   // what the grow pass passes on to the children
+    yui_LayoutCursor cursor; // the children start from
+    yui_Rect clip;
+    bool clipped;
+    bool placed;      // reached by the grow pass, culled boxes are not
+    bool culled;      // a box in the subtree was culled, the keyed boxes above have to know
+} yui_ParallelItem;
+
+typedef struct {
+    bool active;      // this frame is laid out in parallel
+    yui_ParallelItem *items;
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *tasks;  // first item of every task and `count` after the last one
+    uint32_t count_tasks;
+    uint32_t cap_tasks;
+} yui_Parallel;
+
+// Alternative layout engine that keeps the frame as arrays in pre-order, which is the
+// order boxes are opened in, so a box's id is its index and the root is index 0. The
+// fit pass is one backward sweep and grow sizing plus positioning one forward sweep.
+typedef struct {
+    uint8_t  *sizing;
+    int      *fixed;
+    int      *lead;          // margin + padding before the content
+    int      *lead_margin;
+    int      *padding;       // both sides
+    int      *margin;        // both sides
+    int      *content_size;
+    int      *filled;
+    uint32_t *count_grow;
+    int      *padding_size;
+    int      *margin_size;
+    int      *content_pos;
+    int      *padding_pos;
+    uint32_t *cursor;
+    uint8_t  *overflow;
+    int      *scroll;
+} yui_FlatAxis;
+
+typedef struct {
+    bool active; // latched from yui_Ctx.flat_layout in yui_begin_frame
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *parent;
+    uint32_t *subtree_end;
+    uint8_t  *content_dir;
+    yui_Box **boxes;
+    yui_FlatAxis axis[2];
+} yui_FlatLayout;
 
-#define YUI_BOXES_CAP 1024
 typedef struct {
     yui_Box  root;
     yui_Box *curr;
     uint32_t level;
-    yui_Box boxes[YUI_BOXES_CAP];
-    uint32_t count_boxes;
+    yui_BoxArena boxes;
+    yui_StringArena strings;
+    yui_StyleTable styles;       // from yui_style_intern, kept until yui_destroy
+    yui_StyleTable frame_styles; // configs passed by value, emptied by yui_begin_frame
+    uint32_t frame;
+    yui_RetainedTable retained;
+    yui_KeptLayouts kept;
+    yui_DrawList draw_list;
+    yui_Damage damage;
+    yui_FontTable fonts;
+    yui_TextCache text_cache;
+    yui_LineCache line_cache;
+    yui_HitIndex hit_index;
+    yui_Input input;
+    yui_Changes changes;
+    bool flat_layout;
+    bool render_in_layout; // draw during the last layout pass of the tree engine, ignored in
+                           // frames with wrapped text
+    bool draw_offscreen;   // draw subtrees whose margin box is outside the clip rect as well
+    bool cull_layout;      // don't size or position the children of culled boxes either, their
+                           // layout stays what fit sizing left. Tree engine only
+    bool skip_unchanged;   // reuse last frame's layout and draw list for an unchanged frame
+    uint32_t parallel_threshold; // see yui_Parallel, 0 means YUI_PARALLEL_THRESHOLD. Tree engine only
+    yui_Parallel parallel;
+    yui_FlatLayout flat;
+    uint32_t retained_frame; // last frame the retained layouts were refreshed
+    uint32_t layout_frame;   // last frame that was laid out rather than reused
+    uint32_t ended_frame;
+    uint64_t frame_hash;     // of the tree, its scroll offsets and the settings that change the output
+    uint64_t scroll_hash;    // offsets set this frame
+    uint64_t text_pointers;  // addresses of the text given this frame
+    uint64_t drawn_pointers; // text_pointers of the frame the draw list was rendered in
+    uint32_t drawn_boxes;    // count_drawn_boxes of that frame, reported again by reused frames
+    uint32_t count_wrapped;  // wrapped text boxes in the current frame
+    bool relayout;
+    // The n-th wrapped text box of the frame guesses its height from the n-th one of last
+    // frame, which is right whenever the frame did not change
+    struct {
+        uint64_t hash;
+        int height;
+        yui_Box *box;
+    } *wrap_guesses;
+    uint32_t count_wrap_guesses;
+    uint32_t cap_wrap_guesses;
+    yui_FrameStats stats;
 
     struct {
         yui_MeasureTextPfn measure_text;
+        yui_MeasureTextsPfn measure_texts; // optional, measures the words of wrapped text in one call
         yui_DrawTextPfn draw_text;
         yui_DrawRectPfn draw_rect;
         yui_DrawRectOutlinePfn draw_rect_outline;
         yui_BeginScissorModePfn begin_scissor_mode;
         yui_EndScissorModePfn end_scissor_mode;
+        yui_TracePfn trace;
+        void *trace_user;
+        yui_ParallelForPfn parallel_for; // opt-in, layout stays on the calling thread without it
+        void *parallel_user;
     } config;
 } yui_Ctx;
 
+// Thread safety: yui keeps no state outside of yui_Ctx, so separate contexts can be built, laid
+// out and rendered on separate threads at the same time. A context is used by one thread at a
+// time, the one calling yui_begin_frame through yui_end_frame, except for the tasks it hands
+// to config.parallel_for. Callbacks in ctx->config run on that thread, so a callback shared by
+// contexts on different threads, measure_text above all, has to be safe to call concurrently.
+// With ctx->draw_list.items set yui_end_frame records instead of drawing and only the yui_replay
+// functions call the draw callbacks, which keeps the backend on whichever thread replays.
+void yui_destroy(yui_Ctx *ctx);
+void yui_reserve_boxes(yui_Ctx *ctx, uint32_t count);
+void yui_supply_boxes(yui_Ctx *ctx, void *memory, size_t size);
+
 void yui_begin_frame(yui_Ctx *ctx, uint32_t w, uint32_t h);
-void yui_end_frame(yui_Ctx *ctx);
+// Returns false when the frame is the same as the last one: the same tree of configs, text and
+// keys, the same root size, no scroll offset set and the same settings. With skip_unchanged
+// such a frame is not laid out, its boxes keep last frame's layout and damage comes out empty
+// once the back buffers caught up, so the application can skip presenting or wait for input.
+// The draw list keeps last frame's commands when every string is at the address it had then,
+// like literals and yui_text_boxf output formatted the same way. Otherwise it is rendered
+// again from the kept layout, so text only ever has to live until yui_end_frame returns.
+// Without a draw list nothing is drawn.
+bool yui_end_frame(yui_Ctx *ctx);
 yui_Box *yui_open_box(yui_Ctx *ctx, yui_BoxConfig config);
+// Boxes opened with a key keep their identity across frames, the key is hashed together
+// with the parent's key so `index` only has to be unique between siblings. Unkeyed boxes
+// opened inside a keyed box get a key derived from their position in the parent, which
+// identifies them for input but keeps nothing across frames. A keyed subtree that did not
+// change is laid out by moving last frame's layout, so keys on the panels and list items
+// that stay the same are what makes a mostly static frame cheap.
+yui_Box *yui_open_box_keyed(yui_Ctx *ctx, const char *key, uint32_t index, yui_BoxConfig config);
+// Interns `config` for the life of the context, the same config gives the same handle. A
+// handle stays valid across frames until yui_destroy, so it can be interned once up front;
+// only the styles of configs passed by value are dropped every frame. Boxes opened with a
+// handle skip hashing and comparing their config, which the functions taking a config by
+// value do to find the style it shares with the other boxes of the frame.
+yui_StyleId yui_style_intern(yui_Ctx *ctx, yui_BoxConfig config);
+yui_Box *yui_open_box_style(yui_Ctx *ctx, yui_StyleId style);
+yui_Box *yui_open_box_keyed_style(yui_Ctx *ctx, const char *key, uint32_t index, yui_StyleId style);
 void yui_close_box(yui_Ctx *ctx);
 void yui_text_box(yui_Ctx *ctx, const char *text, yui_TextConfig text_config);
+// The padding box of a laid out box less its padding, and with its margin
+yui_Rect yui_content_box(const yui_Box *box);
+yui_Rect yui_margin_box(const yui_Box *box);
+
+#if defined(__GNUC__) || defined(__clang__)
+#define YUI_PRINTF_FORMAT(FMT, ARGS) __attribute__((format(printf, FMT, ARGS)))
+#else
+#define YUI_PRINTF_FORMAT(FMT, ARGS)
+#endif
+// Format into ctx->strings, so the text lives until the next yui_begin_frame without the
+// caller keeping it alive. An encoding error gives an empty string.
+void yui_text_boxf(yui_Ctx *ctx, yui_TextConfig text_config, const char *fmt, ...) YUI_PRINTF_FORMAT(3, 4);
+const char *yui_frame_printf(yui_Ctx *ctx, const char *fmt, ...) YUI_PRINTF_FORMAT(2, 3);
+const char *yui_frame_vprintf(yui_Ctx *ctx, const char *fmt, va_list args);
+
+// Scroll offsets are kept across frames for boxes opened with a key and YUI_OVERFLOW_SCROLL, others
+// only clip. Offsets are clamped to the content during layout, a change made before
+// yui_end_frame shows up in the same frame.
+yui_Point yui_get_scroll(yui_Ctx *ctx, const yui_Box *box);
+void yui_set_scroll(yui_Ctx *ctx, yui_Box *box, yui_Point offset);
+void yui_scroll_by(yui_Ctx *ctx, yui_Box *box, int dx, int dy);
+
+// Only the visible rows of a long list get boxes. Open a keyed box that scrolls along its
+// content direction, call yui_begin_virtual_list, open the rows in [begin, end) and call
+// yui_end_virtual_list before closing the box. Spacer boxes stand in for the rows that are
+// not opened, so `item_extent` is the margin box extent of one row, estimated if rows differ.
+// Rows opened with yui_open_box_keyed(ctx, key, index, ...) keep their identity while scrolling.
+typedef struct {
+    uint32_t begin;
+    uint32_t end;
+    uint32_t count;
+    int item_extent;
+} yui_VirtualList;
+
+yui_VirtualList yui_begin_virtual_list(yui_Ctx *ctx, uint32_t count_items, int item_extent);
+void yui_end_virtual_list(yui_Ctx *ctx, const yui_VirtualList *list);
+
+// Copies `metrics` so yui measures the text of `font` without calling measure_text, see
+// yui_FontMetrics. Registering a font again replaces its metrics and NULL removes them, either
+// way what was measured with the old ones is dropped. Outside of yui_begin_frame/yui_end_frame.
+void yui_register_font(yui_Ctx *ctx, void *font, const yui_FontMetrics *metrics);
+// Width in pixels, rounded up, of the widest line of `text`
+int yui_measure_text(yui_Ctx *ctx, void *font, const char *text, int font_size);
+// Distance between the lines of text in pixels, the one layout uses
+int yui_line_height(yui_Ctx *ctx, void *font, int font_size);
+
+// Drops cached measurements for `font`, or for every font when it is NULL, and every cached
+// line break. Call it whenever a font is reloaded, outside of yui_begin_frame/yui_end_frame.
+void yui_invalidate_text_cache(yui_Ctx *ctx, void *font);
+
+// Issues the commands through the draw callbacks in ctx->config
+void yui_replay(yui_Ctx *ctx, const yui_DrawCommand *commands, uint32_t count);
+
+// Like yui_replay but only redraws the areas in ctx->damage, each one under its own scissor
+void yui_replay_damage(yui_Ctx *ctx, const yui_DrawCommand *commands, uint32_t count);
+
+// The recorded commands of one context, moved by `offset` and, when `clipped` is set, drawn
+// under `clip` which is in the moved coordinates
+typedef struct {
+    const yui_DrawCommand *commands;
+    uint32_t count;
+    yui_Point offset;
+    bool clipped;
+    yui_Rect clip;
+} yui_DrawLayer;
+
+// Issues the layers in order through the draw callbacks in ctx->config, so contexts laid out
+// on other threads end up in one submission. Commands are read in place, not copied.
+void yui_replay_layers(yui_Ctx *ctx, const yui_DrawLayer *layers, uint32_t count);
+
+// Frame snapshots hold the box tree of one frame with its configs, text and what the measure
+// callbacks returned, so the frame can be laid out and rendered again without the application
+// or its fonts. A snapshot is one relocatable block in the byte order of the writer: the header,
+// `count_boxes` records, `count_widths` measured widths and `text_bytes` of NUL-terminated
+// strings, each starting at an 8 byte boundary. It can be used straight from a memory-mapped file.
+#define YUI_SNAPSHOT_MAGIC   0x53495559u // "YUIS"
+#define YUI_SNAPSHOT_VERSION 1
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order;   // 0x01020304 as the writer stores it
+    uint32_t size;         // of the whole snapshot
+    uint32_t root_width;
+    uint32_t root_height;
+    uint32_t count_boxes;  // the root is not recorded
+    uint32_t count_fonts;
+    uint32_t count_widths;
+    uint32_t text_bytes;
+} yui_SnapshotHeader;
+
+typedef struct {
+    uint64_t key;
+    uint32_t parent;       // id of the parent, the root is 0 and record i is box i + 1
+    uint32_t font;         // 0 for none, else 1 + index into the fonts given to yui_load_snapshot
+    uint32_t text;         // offset into the strings, UINT32_MAX for boxes that are not text boxes
+    uint32_t widths;       // index of the first measured width of a text box: its width, or for
+    uint32_t count_widths; // wrapped text one per word and the width of a space
+    int32_t font_size;
+    int32_t fixed_width;
+    int32_t fixed_height;
+    int32_t padding[4];
+    int32_t margin[4];
+    int32_t border_width;
+    float roundness;
+    int32_t scroll[2];
+    uint8_t overflow[2];
+    uint8_t sizing[2];
+    uint8_t content_dir;
+    uint8_t wrap;
+    uint8_t reserved[2];
+    yui_Color background_color;
+    yui_Color border_color;
+    yui_Color text_color;
+} yui_SnapshotBox;
+
+// Writes a snapshot of the current frame into `buffer` when it is big enough and returns its
+// size either way. Call it after the last yui_close_box of a frame and before the next
+// yui_begin_frame, yui_end_frame included.
+size_t yui_write_snapshot(yui_Ctx *ctx, void *buffer, size_t size);
+// Begins a frame and builds the tree of the snapshot in it without calling the measure
+// callbacks, yui_end_frame lays it out and renders it as usual. `fonts` maps the font indices
+// of the snapshot back to fonts, without enough of them text gets stand-ins that are only good
+// for recording, (void *)(uintptr_t)(1 + index). `data` has to be 8 byte aligned. Returns
+// false without beginning a frame when the snapshot is malformed or from another version.
+bool yui_load_snapshot(yui_Ctx *ctx, const void *data, size_t size, void *const *fonts, uint32_t count_fonts);
+
+// Writes `event` as one Chrome trace-event JSON object, a frame is a JSON array of them.
+// Returns what snprintf would. Only available when yui.c is built with YUI_TRACE.
+int yui_trace_event_json(const yui_TraceEvent *event, char *buffer, size_t size);
 
 yui_Box *yui_hit_test(yui_Box *box, int x, int y);
+// Queries against ctx->hit_index, call them after yui_end_frame. The boxes returned
+// stay valid until the next yui_begin_frame.
+yui_Box *yui_hit_test_top(yui_Ctx *ctx, int x, int y);
+void yui_hit_test_points(yui_Ctx *ctx, const yui_Point *points, uint32_t count, yui_Box **results);
+// Writes up to `cap` boxes that intersect `rect` in no particular order and returns how many there are
+uint32_t yui_query_rect(yui_Ctx *ctx, yui_Rect rect, yui_Box **results, uint32_t cap);
+
+// Call before yui_begin_frame, which hit tests the pointer once against last frame's layout.
+// The queries below then answer while the frame is built, so widgets react to input in the
+// frame it arrives in rather than the next one, without hit testing themselves.
+void yui_set_pointer(yui_Ctx *ctx, int x, int y, bool down);
+yui_Interaction yui_get_interaction(yui_Ctx *ctx, const yui_Box *box);
+// For the box the next yui_open_box_keyed(ctx, key, index, ...) in the current box opens, so
+// its config can depend on it
+yui_Interaction yui_get_interaction_keyed(yui_Ctx *ctx, const char *key, uint32_t index);
+bool yui_is_hovered(yui_Ctx *ctx, const yui_Box *box);
 
 #endif // YUI_H_
+
+// Single translation unit build: define YUI_IMPLEMENTATION in one source file before it includes
+// yui.h and the implementation comes with it, next to the backend. Backend functions given there
+// as YUI_BACKEND_* macros, listed in yui.c, are then bound at compile time. yui.c must not
+// be built on its own as well. Without it yui.c is a separate translation unit and the backend
+// is the runtime callbacks in yui_Ctx.config.
+#if defined(YUI_IMPLEMENTATION) && !defined(YUI_IMPLEMENTATION_INCLUDED)
+#define YUI_IMPLEMENTATION_INCLUDED
+#include "yui.c"
+#endif
@@ -0,0 +1,265 @@
+#include "yui_mesh.h"
+#include "yui_utf8.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef YUI_REALLOC
+#define YUI_REALLOC realloc
+#endif
+#ifndef YUI_FREE
+#define YUI_FREE free
+#endif
+
+#define internal static
+
+#define MY_MIN(A, B) ((A) < (B) ? (A) : (B))
+#define MY_MAX(A, B) ((A) > (B) ? (A) : (B))
+
+#define RESERVE(ARRAY, CAP, NEEDED) do { \
+        if((NEEDED) > (CAP)) { \
+            uint32_t cap = (CAP) ? (CAP) : 256; \
+            while(cap < (NEEDED)) cap *= 2; \
+            void *items = YUI_REALLOC((ARRAY), (size_t)cap*sizeof(*(ARRAY))); \
+            assert(items != NULL && "Out of memory"); \
+            (ARRAY) = items; \
+            (CAP) = cap; \
+        } \
+    } while(0)
+
+// Bounds on what a command can add, so the writers below never check for room
+internal void _reserve(yui_Mesh *mesh, const yui_DrawCommand *commands, uint32_t count, uint32_t segments)
+{
+    uint64_t vertices = 0;
+    uint64_t indices = 0;
+    for(uint32_t i = 0; i < count; ++i) {
+        const yui_DrawCommand *cmd = &commands[i];
+        switch(cmd->kind) {
+        case YUI_DRAW_RECT:
+            vertices += cmd->roundness > 0 ? 1 + 4*(segments + 1) : 4;
+            indices  += cmd->roundness > 0 ? 12*(segments + 1) : 6;
+            break;
+        case YUI_DRAW_RECT_OUTLINE:
+            vertices += 8;
+            indices  += 24;
+            break;
+        case YUI_DRAW_TEXT:
+            // A glyph takes at least one byte
+            if(mesh->glyph && cmd->text.str) {
+                size_t length = strlen(cmd->text.str);
+                vertices += 4*length;
+                indices  += 6*length;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    assert(vertices <= UINT32_MAX && indices <= UINT32_MAX && "Mesh too large");
+    RESERVE(mesh->vertices, mesh->cap_vertices, (uint32_t)vertices);
+    RESERVE(mesh->indices, mesh->cap_indices, (uint32_t)indices);
+    RESERVE(mesh->batches, mesh->cap_batches, count + 1);
+}
+
+internal void _update_arc(yui_Mesh *mesh, uint32_t segments)
+{
+    if(mesh->arc_segments == segments) return;
+    for(uint32_t i = 0; i <= segments; ++i) {
+        double angle = 1.57079632679489661923*i/segments;
+        mesh->arc[i][0] = (float)cos(angle);
+        mesh->arc[i][1] = (float)sin(angle);
+    }
+    mesh->arc_segments = segments;
+}
+
+// The last batch when it has the same state, else a new one
+internal void _use_batch(yui_Mesh *mesh, void *texture, bool clipped, yui_Rect clip)
+{
+    yui_MeshBatch *last = mesh->count_batches ? &mesh->batches[mesh->count_batches - 1] : NULL;
+    if(last && last->texture == texture && last->clipped == clipped &&
+            (!clipped || (last->clip.x == clip.x && last->clip.y == clip.y && last->clip.w == clip.w && last->clip.h == clip.h)))
+        return;
+    if(last == NULL || last->count_indices > 0) {
+        // Every command opens at most one batch besides the glyph textures of text,
+        // which only switch between atlas pages
+        if(mesh->count_batches == mesh->cap_batches) RESERVE(mesh->batches, mesh->cap_batches, mesh->cap_batches + 1);
+        last = &mesh->batches[mesh->count_batches++];
+        last->first_index = mesh->count_indices;
+        last->count_indices = 0;
+    }
+    last->texture = texture;
+    last->clipped = clipped;
+    last->clip = clip;
+}
+
+internal inline void _vertex(yui_MeshVertex *v, float x, float y, float u, float t, yui_Color color)
+{
+    v->x = x;
+    v->y = y;
+    v->u = u;
+    v->v = t;
+    v->color = color;
+}
+
+internal void _push_quad(yui_Mesh *mesh, float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, yui_Color color)
+{
+    uint32_t base = mesh->count_vertices;
+    yui_MeshVertex *v = &mesh->vertices[base];
+    _vertex(&v[0], x0, y0, u0, v0, color);
+    _vertex(&v[1], x1, y0, u1, v0, color);
+    _vertex(&v[2], x1, y1, u1, v1, color);
+    _vertex(&v[3], x0, y1, u0, v1, color);
+    uint32_t *i = &mesh->indices[mesh->count_indices];
+    i[0] = base; i[1] = base + 1; i[2] = base + 2;
+    i[3] = base; i[4] = base + 2; i[5] = base + 3;
+    mesh->count_vertices += 4;
+    mesh->count_indices += 6;
+    mesh->batches[mesh->count_batches - 1].count_indices += 6;
+}
+
+// A fan around the center through the four corner arcs, clockwise from the left end of the
+// top left arc
+internal void _push_rounded_rect(yui_Mesh *mesh, yui_Rect rect, float radius, yui_Color color)
+{
+    uint32_t segments = mesh->arc_segments;
+    float u = mesh->white_u, t = mesh->white_v;
+    float x0 = (float)rect.x + radius, x1 = (float)(rect.x + rect.w) - radius;
+    float y0 = (float)rect.y + radius, y1 = (float)(rect.y + rect.h) - radius;
+    uint32_t center = mesh->count_vertices;
+    yui_MeshVertex *v = &mesh->vertices[center];
+    _vertex(v++, (float)rect.x + (float)rect.w/2, (float)rect.y + (float)rect.h/2, u, t, color);
+    for(uint32_t i = 0; i <= segments; ++i) {
+        float c = radius*mesh->arc[i][0], s = radius*mesh->arc[i][1];
+        _vertex(&v[i],                      x0 - c, y0 - s, u, t, color);
+        _vertex(&v[i + (segments + 1)],     x1 + s, y0 - c, u, t, color);
+        _vertex(&v[i + 2*(segments + 1)],   x1 + c, y1 + s, u, t, color);
+        _vertex(&v[i + 3*(segments + 1)],   x0 - s, y1 + c, u, t, color);
+    }
+    uint32_t count = 4*(segments + 1);
+    uint32_t *index = &mesh->indices[mesh->count_indices];
+    for(uint32_t k = 0; k < count; ++k) {
+        index[3*k]     = center;
+        index[3*k + 1] = center + 1 + k;
+        index[3*k + 2] = center + 1 + (k + 1 == count ? 0 : k + 1);
+    }
+    mesh->count_vertices += 1 + count;
+    mesh->count_indices += 3*count;
+    mesh->batches[mesh->count_batches - 1].count_indices += 3*count;
+}
+
+// Four sides inside the rect, like DrawRectangleLinesEx
+internal void _push_outline(yui_Mesh *mesh, yui_Rect rect, int border_width, yui_Color color)
+{
+    float b = (float)MY_MIN(border_width, MY_MIN(rect.w, rect.h)/2);
+    float u = mesh->white_u, t = mesh->white_v;
+    float x0 = (float)rect.x, x1 = (float)(rect.x + rect.w);
+    float y0 = (float)rect.y, y1 = (float)(rect.y + rect.h);
+    uint32_t base = mesh->count_vertices;
+    yui_MeshVertex *v = &mesh->vertices[base];
+    _vertex(&v[0], x0, y0, u, t, color);
+    _vertex(&v[1], x1, y0, u, t, color);
+    _vertex(&v[2], x1, y1, u, t, color);
+    _vertex(&v[3], x0, y1, u, t, color);
+    _vertex(&v[4], x0 + b, y0 + b, u, t, color);
+    _vertex(&v[5], x1 - b, y0 + b, u, t, color);
+    _vertex(&v[6], x1 - b, y1 - b, u, t, color);
+    _vertex(&v[7], x0 + b, y1 - b, u, t, color);
+    uint32_t *index = &mesh->indices[mesh->count_indices];
+    for(uint32_t k = 0; k < 4; ++k) {
+        uint32_t next = (k + 1) & 3;
+        index[6*k]     = base + k;
+        index[6*k + 1] = base + next;
+        index[6*k + 2] = base + 4 + next;
+        index[6*k + 3] = base + k;
+        index[6*k + 4] = base + 4 + next;
+        index[6*k + 5] = base + 4 + k;
+    }
+    mesh->count_vertices += 8;
+    mesh->count_indices += 24;
+    mesh->batches[mesh->count_batches - 1].count_indices += 24;
+}
+
+internal void _push_text(yui_Mesh *mesh, const yui_DrawCommand *cmd, bool clipped, yui_Rect clip)
+{
+    float x = (float)cmd->rect.x;
+    float y = (float)cmd->rect.y;
+    const unsigned char *s = (const unsigned char *)cmd->text.str;
+    float line_height = 0;
+    while(*s) {
+        uint32_t codepoint = yui_decode_utf8(&s);
+        if(codepoint == '\n') {
+            x = (float)cmd->rect.x;
+            if(line_height == 0)
+                line_height = (float)(mesh->ctx ? yui_line_height(mesh->ctx, cmd->text.font, cmd->text.font_size) : cmd->text.font_size);
+            y += line_height;
+            continue;
+        }
+        yui_MeshGlyph glyph = {0};
+        mesh->glyph(mesh->glyph_user, cmd->text.font, cmd->text.font_size, codepoint, &glyph);
+        if(glyph.x1 > glyph.x0 && glyph.y1 > glyph.y0) {
+            _use_batch(mesh, glyph.texture, clipped, clip);
+            _push_quad(mesh, x + glyph.x0, y + glyph.y0, x + glyph.x1, y + glyph.y1,
+                    glyph.u0, glyph.v0, glyph.u1, glyph.v1, cmd->color);
+        }
+        x += glyph.advance;
+    }
+}
+
+void yui_mesh_build(yui_Mesh *mesh, const yui_DrawCommand *commands, uint32_t count)
+{
+    uint32_t segments = mesh->segments ? MY_MIN(mesh->segments, YUI_MESH_MAX_SEGMENTS) : YUI_MESH_SEGMENTS;
+    _update_arc(mesh, segments);
+    _reserve(mesh, commands, count, segments);
+    mesh->count_vertices = 0;
+    mesh->count_indices = 0;
+    mesh->count_batches = 0;
+
+    bool clipped = false;
+    yui_Rect clip = {0};
+    for(uint32_t i = 0; i < count; ++i) {
+        const yui_DrawCommand *cmd = &commands[i];
+        switch(cmd->kind) {
+        case YUI_DRAW_RECT: {
+            if(cmd->rect.w <= 0 || cmd->rect.h <= 0) break;
+            float radius = cmd->roundness > 0 ? MY_MIN(cmd->roundness, 1.0f)*(float)MY_MIN(cmd->rect.w, cmd->rect.h)/2.0f : 0;
+            _use_batch(mesh, mesh->white_texture, clipped, clip);
+            if(radius >= 1.0f) {
+                _push_rounded_rect(mesh, cmd->rect, radius, cmd->color);
+            } else {
+                _push_quad(mesh, (float)cmd->rect.x, (float)cmd->rect.y, (float)(cmd->rect.x + cmd->rect.w), (float)(cmd->rect.y + cmd->rect.h),
+                        mesh->white_u, mesh->white_v, mesh->white_u, mesh->white_v, cmd->color);
+            }
+        } break;
+        case YUI_DRAW_RECT_OUTLINE:
+            if(cmd->rect.w <= 0 || cmd->rect.h <= 0 || cmd->border_width <= 0) break;
+            _use_batch(mesh, mesh->white_texture, clipped, clip);
+            _push_outline(mesh, cmd->rect, cmd->border_width, cmd->color);
+            break;
+        case YUI_DRAW_TEXT:
+            if(mesh->glyph && cmd->text.str) _push_text(mesh, cmd, clipped, clip);
+            break;
+        case YUI_DRAW_SCISSOR_PUSH:
+            clipped = true;
+            clip = cmd->rect;
+            break;
+        case YUI_DRAW_SCISSOR_POP:
+            clipped = cmd->restore;
+            clip = cmd->restore ? cmd->rect : (yui_Rect){0};
+            break;
+        }
+    }
+    if(mesh->count_batches > 0 && mesh->batches[mesh->count_batches - 1].count_indices == 0) mesh->count_batches -= 1;
+}
+
+void yui_mesh_free(yui_Mesh *mesh)
+{
+    YUI_FREE(mesh->vertices);
+    YUI_FREE(mesh->indices);
+    YUI_FREE(mesh->batches);
+    mesh->vertices = NULL;
+    mesh->indices = NULL;
+    mesh->batches = NULL;
+    mesh->count_vertices = mesh->count_indices = mesh->count_batches = 0;
+    mesh->cap_vertices = mesh->cap_indices = mesh->cap_batches = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef YUI_MESH_H_
+#define YUI_MESH_H_
+
+#include "yui.h"
+
+// Tessellates a recorded command list into one interleaved vertex buffer and one index
+// buffer for GPU backends. Batches only break where the texture or the scissor changes, so
+// with a white texel in the glyph atlas a frame without scissors is a single draw call.
+// Triangles are in painter's order, draw them without depth testing and with alpha blending.
+// The buffers are kept across builds and only grow, a steady frame does not allocate.
+
+// A glyph in the caller's atlas. The quad is relative to the pen, which starts at the top
+// left of the text, and is skipped when empty. `advance` moves the pen to the next glyph.
+typedef struct {
+    float x0, y0, x1, y1;
+    float u0, v0, u1, v1;
+    float advance;
+    void *texture;
+} yui_MeshGlyph;
+
+typedef void (*yui_MeshGlyphPfn)(void *user, void *font, int font_size, uint32_t codepoint, yui_MeshGlyph *glyph);
+
+typedef struct {
+    float x, y;
+    float u, v;
+    yui_Color color;
+} yui_MeshVertex;
+
+// Draw `count_indices` indices from `first_index`, under `clip` when `clipped` is set
+typedef struct {
+    void *texture;
+    bool clipped;
+    yui_Rect clip;
+    uint32_t first_index;
+    uint32_t count_indices;
+} yui_MeshBatch;
+
+#define YUI_MESH_SEGMENTS 8      // per rounded corner
+#define YUI_MESH_MAX_SEGMENTS 32
+
+typedef struct {
+    yui_MeshGlyphPfn glyph;      // text is skipped without it
+    void *glyph_user;
+    // Solid geometry samples `white_texture` at (white_u, white_v) so it can share batches
+    // with text, NULL gives it batches of its own with a NULL texture
+    void *white_texture;
+    float white_u, white_v;
+    uint32_t segments;           // per rounded corner, 0 means YUI_MESH_SEGMENTS
+    // Puts lines of text as far apart as the layout of `ctx` did, see yui_line_height.
+    // Without it they are font_size apart, which is right unless the font is registered.
+    yui_Ctx *ctx;
+
+    // Written by yui_mesh_build, valid until the next build
+    yui_MeshVertex *vertices;
+    uint32_t count_vertices;
+    uint32_t *indices;
+    uint32_t count_indices;
+    yui_MeshBatch *batches;
+    uint32_t count_batches;
+
+    uint32_t cap_vertices;
+    uint32_t cap_indices;
+    uint32_t cap_batches;
+    uint32_t arc_segments;       // `arc` holds the unit quarter circle for this many segments
+    float arc[YUI_MESH_MAX_SEGMENTS + 1][2];
+} yui_Mesh;
+
+// Replaces the mesh with the tessellation of `commands`, rects take the radius
+// yui_soft_draw_rect gives them
+void yui_mesh_build(yui_Mesh *mesh, const yui_DrawCommand *commands, uint32_t count);
+void yui_mesh_free(yui_Mesh *mesh);
+
+#endif // YUI_MESH_H_
@@ -0,0 +1,181 @@
+#include "yui_pool.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define internal static
+
+// A range is [begin, end) with begin in the low 32 bits, so taking from the front and
+// stealing from the back are both a single compare and swap
+#define RANGE(BEGIN, END) ((uint64_t)(END) << 32 | (uint32_t)(BEGIN))
+#define RANGE_BEGIN(R) ((uint32_t)(R))
+#define RANGE_END(R) ((uint32_t)((R) >> 32))
+
+typedef struct {
+    yui_Pool *pool;
+    uint32_t index;
+    thrd_t thread;
+} yui_PoolWorker;
+
+struct yui_Pool {
+    uint32_t count_threads; // workers and the calling thread
+    yui_PoolWorker *workers;
+    _Atomic uint64_t *ranges;
+
+    mtx_t lock;
+    cnd_t wake;
+    cnd_t done;
+    uint64_t generation;    // bumped for every call
+    uint32_t busy;          // workers still inside the current call
+    bool quit;
+
+    yui_TaskPfn task;
+    void *data;
+};
+
+internal bool _take(_Atomic uint64_t *range, uint32_t *index)
+{
+    uint64_t r = atomic_load(range);
+    while(RANGE_BEGIN(r) < RANGE_END(r)) {
+        if(atomic_compare_exchange_weak(range, &r, RANGE(RANGE_BEGIN(r) + 1, RANGE_END(r)))) {
+            *index = RANGE_BEGIN(r);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Moves the back half of the largest range into the empty range of `self`
+internal bool _steal(yui_Pool *pool, uint32_t self)
+{
+    for(;;) {
+        uint32_t victim = self;
+        uint64_t r = 0;
+        uint32_t largest = 0;
+        for(uint32_t i = 0; i < pool->count_threads; ++i) {
+            uint64_t candidate = atomic_load(&pool->ranges[i]);
+            uint32_t size = RANGE_END(candidate) - RANGE_BEGIN(candidate);
+            if(RANGE_BEGIN(candidate) < RANGE_END(candidate) && size > largest) {
+                victim = i;
+                r = candidate;
+                largest = size;
+            }
+        }
+        if(largest == 0) return false;
+        uint32_t mid = RANGE_BEGIN(r) + largest/2;
+        if(atomic_compare_exchange_strong(&pool->ranges[victim], &r, RANGE(RANGE_BEGIN(r), mid))) {
+            atomic_store(&pool->ranges[self], RANGE(mid, RANGE_END(r)));
+            return true;
+        }
+    }
+}
+
+internal void _run(yui_Pool *pool, uint32_t self)
+{
+    uint32_t index;
+    do {
+        while(_take(&pool->ranges[self], &index)) pool->task(pool->data, index);
+    } while(_steal(pool, self));
+}
+
+internal int _worker_main(void *arg)
+{
+    yui_PoolWorker *worker = arg;
+    yui_Pool *pool = worker->pool;
+    uint64_t seen = 0;
+    mtx_lock(&pool->lock);
+    for(;;) {
+        while(pool->generation == seen && !pool->quit) cnd_wait(&pool->wake, &pool->lock);
+        if(pool->quit) break;
+        seen = pool->generation;
+        mtx_unlock(&pool->lock);
+        _run(pool, worker->index);
+        mtx_lock(&pool->lock);
+        if(--pool->busy == 0) cnd_signal(&pool->done);
+    }
+    mtx_unlock(&pool->lock);
+    return 0;
+}
+
+yui_Pool *yui_pool_create(uint32_t count_workers)
+{
+    yui_Pool *pool = calloc(1, sizeof(*pool));
+    if(pool == NULL) return NULL;
+    pool->count_threads = 1;
+    pool->workers = calloc(count_workers + 1, sizeof(*pool->workers));
+    pool->ranges  = calloc(count_workers + 1, sizeof(*pool->ranges));
+    bool lock = pool->workers && pool->ranges && mtx_init(&pool->lock, mtx_plain) == thrd_success;
+    bool wake = lock && cnd_init(&pool->wake) == thrd_success;
+    bool done = wake && cnd_init(&pool->done) == thrd_success;
+    if(!done) {
+        if(wake) cnd_destroy(&pool->wake);
+        if(lock) mtx_destroy(&pool->lock);
+        free(pool->workers);
+        free((void *)pool->ranges);
+        free(pool);
+        return NULL;
+    }
+    // Worker i uses ranges[i], the calling thread ranges[0]. count_threads only counts the
+    // workers that started, so a failed start joins exactly those.
+    for(uint32_t i = 1; i <= count_workers; ++i) {
+        yui_PoolWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        if(thrd_create(&worker->thread, _worker_main, worker) != thrd_success) {
+            yui_pool_destroy(pool);
+            return NULL;
+        }
+        pool->count_threads = i + 1;
+    }
+    return pool;
+}
+
+void yui_pool_destroy(yui_Pool *pool)
+{
+    if(pool == NULL) return;
+    mtx_lock(&pool->lock);
+    pool->quit = true;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+    for(uint32_t i = 1; i < pool->count_threads; ++i) thrd_join(pool->workers[i].thread, NULL);
+    cnd_destroy(&pool->wake);
+    cnd_destroy(&pool->done);
+    mtx_destroy(&pool->lock);
+    free(pool->workers);
+    free((void *)pool->ranges);
+    free(pool);
+}
+
+void yui_pool_parallel_for(void *user, yui_TaskPfn task, void *data, uint32_t count)
+{
+    yui_Pool *pool = user;
+    if(count == 0) return;
+    if(count == 1 || pool->count_threads == 1) {
+        for(uint32_t i = 0; i < count; ++i) task(data, i);
+        return;
+    }
+
+    uint32_t n = pool->count_threads;
+    for(uint32_t i = 0; i < n; ++i)
+        atomic_store(&pool->ranges[i], RANGE((uint64_t)count*i/n, (uint64_t)count*(i + 1)/n));
+    mtx_lock(&pool->lock);
+    pool->task = task;
+    pool->data = data;
+    pool->busy = n - 1;
+    pool->generation += 1;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+
+    _run(pool, 0);
+
+    // Workers can still be running the tasks they took last
+    mtx_lock(&pool->lock);
+    while(pool->busy > 0) cnd_wait(&pool->done, &pool->lock);
+    mtx_unlock(&pool->lock);
+}
+
+void yui_pool_install(yui_Ctx *ctx, yui_Pool *pool)
+{
+    ctx->config.parallel_for = yui_pool_parallel_for;
+    ctx->config.parallel_user = pool;
+}
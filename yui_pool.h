@@ -0,0 +1,20 @@
+#ifndef YUI_POOL_H_
+#define YUI_POOL_H_
+
+#include "yui.h"
+
+// Small work-stealing thread pool for yui_Ctx.config.parallel_for, built on C11 threads.
+// A call splits [0, count) into one range per thread, the calling thread included. Every
+// thread takes indices from the front of its own range and, once that is empty, steals
+// the back half of the largest range left. Only one call at a time per pool.
+typedef struct yui_Pool yui_Pool;
+
+// `count_workers` threads besides the caller, NULL when they can't be started
+yui_Pool *yui_pool_create(uint32_t count_workers);
+void yui_pool_destroy(yui_Pool *pool);
+void yui_pool_parallel_for(void *pool, yui_TaskPfn task, void *data, uint32_t count);
+
+// Points ctx->config.parallel_for at the pool
+void yui_pool_install(yui_Ctx *ctx, yui_Pool *pool);
+
+#endif // YUI_POOL_H_
@@ -0,0 +1,304 @@
+#include "yui_soft.h"
+#include <math.h>
+#include <string.h>
+
+// Define YUI_SOFT_NO_SIMD to force the scalar path
+#if !defined(YUI_SOFT_NO_SIMD) && defined(__AVX2__)
+#define SOFT_AVX2
+#define SOFT_SSE2
+#include <immintrin.h>
+#elif !defined(YUI_SOFT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define SOFT_SSE2
+#include <emmintrin.h>
+#endif
+
+#define internal static
+
+#define MY_MIN(A, B) ((A) < (B) ? (A) : (B))
+#define MY_MAX(A, B) ((A) > (B) ? (A) : (B))
+
+// 5x7 glyphs for ASCII 0x20..0x7E, one byte per column, bit 0 is the top row
+static const uint8_t font5x7[95][5] = {
+    {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+    {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00},
+    {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08},
+    {0x00,0x80,0x70,0x30,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x00,0x60,0x60,0x00}, {0x20,0x10,0x08,0x04,0x02},
+    {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33},
+    {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07},
+    {0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, {0x00,0x00,0x14,0x00,0x00}, {0x00,0x40,0x34,0x00,0x00},
+    {0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06},
+    {0x3E,0x41,0x5D,0x59,0x4E}, {0x7C,0x12,0x11,0x12,0x7C}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+    {0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x41,0x51,0x73},
+    {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+    {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x1C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+    {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x26,0x49,0x49,0x49,0x32},
+    {0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+    {0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03}, {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41},
+    {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+    {0x00,0x03,0x07,0x08,0x00}, {0x20,0x54,0x54,0x78,0x40}, {0x7F,0x28,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x28},
+    {0x38,0x44,0x44,0x28,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x00,0x08,0x7E,0x09,0x02}, {0x18,0xA4,0xA4,0x9C,0x78},
+    {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x40,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+    {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x78,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+    {0xFC,0x18,0x24,0x24,0x18}, {0x18,0x24,0x24,0x18,0xFC}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x24},
+    {0x04,0x04,0x3F,0x44,0x24}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+    {0x44,0x28,0x10,0x28,0x44}, {0x4C,0x90,0x90,0x90,0x7C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+    {0x00,0x00,0x77,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x02,0x01,0x02,0x04,0x02},
+};
+
+#define GLYPH_ADVANCE 6
+#define GLYPH_ROWS    8
+
+internal inline int _glyph_scale(int font_size)
+{
+    return MY_MAX(font_size/GLYPH_ROWS, 1);
+}
+
+internal inline yui_Rect _intersect(yui_Rect a, yui_Rect b)
+{
+    int l = MY_MAX(a.x, b.x);
+    int t = MY_MAX(a.y, b.y);
+    int r = MY_MIN(a.x + a.w, b.x + b.w);
+    int d = MY_MIN(a.y + a.h, b.y + b.h);
+    return (yui_Rect){ l, t, MY_MAX(r - l, 0), MY_MAX(d - t, 0) };
+}
+
+// Blending is src*a + dst*(255 - a) divided by 255 with rounding, the alpha channel
+// blends as if the source alpha were 255. Every path below computes exactly this.
+internal inline uint8_t _blend_channel(uint32_t src_times_a, uint8_t dst, uint32_t inv_a)
+{
+    uint32_t t = src_times_a + dst*inv_a;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+internal void _fill_span(uint8_t *row, int x0, int x1, yui_Color c)
+{
+    if(x0 >= x1 || c.a == 0) return;
+    uint8_t *p = row + (size_t)x0*4;
+    int n = x1 - x0;
+    int i = 0;
+    if(c.a == 0xFF) {
+        uint32_t pixel;
+        memcpy(&pixel, &c, 4);
+#ifdef SOFT_AVX2
+        __m256i v8 = _mm256_set1_epi32((int)pixel);
+        for(; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i*)(p + i*4), v8);
+#endif
+#ifdef SOFT_SSE2
+        __m128i v4 = _mm_set1_epi32((int)pixel);
+        for(; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i*)(p + i*4), v4);
+#endif
+        for(; i < n; ++i) memcpy(p + i*4, &pixel, 4);
+        return;
+    }
+
+    uint32_t a = c.a, inv_a = 255 - a;
+    uint32_t sr = c.r*a + 128, sg = c.g*a + 128, sb = c.b*a + 128, sa = 255*a + 128;
+#ifdef SOFT_AVX2
+    {
+        __m256i src  = _mm256_setr_epi16((short)sr, (short)sg, (short)sb, (short)sa, (short)sr, (short)sg, (short)sb, (short)sa,
+                                         (short)sr, (short)sg, (short)sb, (short)sa, (short)sr, (short)sg, (short)sb, (short)sa);
+        __m256i inv  = _mm256_set1_epi16((short)inv_a);
+        __m256i zero = _mm256_setzero_si256();
+        for(; i + 8 <= n; i += 8) {
+            __m256i dst = _mm256_loadu_si256((const __m256i*)(p + i*4));
+            __m256i lo = _mm256_add_epi16(src, _mm256_mullo_epi16(_mm256_unpacklo_epi8(dst, zero), inv));
+            __m256i hi = _mm256_add_epi16(src, _mm256_mullo_epi16(_mm256_unpackhi_epi8(dst, zero), inv));
+            lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+            hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+            _mm256_storeu_si256((__m256i*)(p + i*4), _mm256_packus_epi16(lo, hi));
+        }
+    }
+#endif
+#ifdef SOFT_SSE2
+    {
+        __m128i src  = _mm_setr_epi16((short)sr, (short)sg, (short)sb, (short)sa, (short)sr, (short)sg, (short)sb, (short)sa);
+        __m128i inv  = _mm_set1_epi16((short)inv_a);
+        __m128i zero = _mm_setzero_si128();
+        for(; i + 4 <= n; i += 4) {
+            __m128i dst = _mm_loadu_si128((const __m128i*)(p + i*4));
+            __m128i lo = _mm_add_epi16(src, _mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inv));
+            __m128i hi = _mm_add_epi16(src, _mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inv));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128((__m128i*)(p + i*4), _mm_packus_epi16(lo, hi));
+        }
+    }
+#endif
+    for(; i < n; ++i) {
+        uint8_t *q = p + i*4;
+        q[0] = _blend_channel(sr, q[0], inv_a);
+        q[1] = _blend_channel(sg, q[1], inv_a);
+        q[2] = _blend_channel(sb, q[2], inv_a);
+        q[3] = _blend_channel(sa, q[3], inv_a);
+    }
+}
+
+internal void _fill_rect(yui_SoftTarget *target, yui_Rect rect, yui_Color color)
+{
+    rect = _intersect(rect, target->clip);
+    for(int y = rect.y; y < rect.y + rect.h; ++y)
+        _fill_span(target->pixels + (size_t)y*target->stride, rect.x, rect.x + rect.w, color);
+}
+
+void yui_soft_init(yui_SoftTarget *target, void *pixels, int width, int height, int stride)
+{
+    target->pixels = pixels;
+    target->width  = width;
+    target->height = height;
+    target->stride = stride ? stride : width*4;
+    target->clip   = (yui_Rect){ 0, 0, width, height };
+}
+
+void yui_soft_clear(yui_SoftTarget *target, yui_Color color)
+{
+    yui_Rect clip = target->clip;
+    target->clip = (yui_Rect){ 0, 0, target->width, target->height };
+    color.a = 0xFF;
+    _fill_rect(target, target->clip, color);
+    target->clip = clip;
+}
+
+// Same radius as raylib's DrawRectangleRounded, roundness is a fraction of half the shorter side
+void yui_soft_draw_rect(yui_SoftTarget *target, yui_Rect rect, yui_Color color, float roundness)
+{
+    int radius = 0;
+    if(roundness > 0) radius = (int)(MY_MIN(roundness, 1.0f)*(float)MY_MIN(rect.w, rect.h)/2.0f);
+    if(radius <= 0) {
+        _fill_rect(target, rect, color);
+        return;
+    }
+    yui_Rect clip = _intersect(rect, target->clip);
+    for(int y = clip.y; y < clip.y + clip.h; ++y) {
+        int row = y - rect.y;
+        int dy = 0;
+        if(row < radius) dy = radius - row;
+        else if(row >= rect.h - radius) dy = row - (rect.h - radius) + 1;
+        int inset = 0;
+        if(dy > 0) {
+            double d = (double)dy - 0.5;
+            inset = radius - (int)(sqrt((double)radius*radius - d*d) + 0.5);
+        }
+        int x0 = MY_MAX(rect.x + inset, clip.x);
+        int x1 = MY_MIN(rect.x + rect.w - inset, clip.x + clip.w);
+        _fill_span(target->pixels + (size_t)y*target->stride, x0, x1, color);
+    }
+}
+
+void yui_soft_draw_rect_outline(yui_SoftTarget *target, yui_Rect rect, yui_Color color, int border_width)
+{
+    int b = MY_MIN(border_width, MY_MIN(rect.w, rect.h));
+    if(b <= 0) return;
+    // No pixel is covered twice, so translucent borders blend once even when the sides meet
+    int bottom = MY_MAX(rect.y + rect.h - b, rect.y + b);
+    int right  = MY_MAX(rect.x + rect.w - b, rect.x + b);
+    _fill_rect(target, (yui_Rect){ rect.x, rect.y, rect.w, b }, color);
+    _fill_rect(target, (yui_Rect){ rect.x, bottom, rect.w, rect.y + rect.h - bottom }, color);
+    _fill_rect(target, (yui_Rect){ rect.x, rect.y + b, b, bottom - rect.y - b }, color);
+    _fill_rect(target, (yui_Rect){ right, rect.y + b, rect.x + rect.w - right, bottom - rect.y - b }, color);
+}
+
+int yui_soft_measure_text(void *font, const char *text, int font_size)
+{
+    (void)font;
+    return (int)strlen(text)*GLYPH_ADVANCE*_glyph_scale(font_size);
+}
+
+void yui_soft_draw_text(yui_SoftTarget *target, const char *text, int font_size, int x, int y, yui_Color color)
+{
+    int scale = _glyph_scale(font_size);
+    for(; *text; ++text, x += GLYPH_ADVANCE*scale) {
+        uint8_t ch = (uint8_t)*text;
+        if(ch < 0x20 || ch > 0x7E) ch = '?';
+        const uint8_t *glyph = font5x7[ch - 0x20];
+        yui_Rect cell = _intersect((yui_Rect){ x, y, 5*scale, GLYPH_ROWS*scale }, target->clip);
+        if(cell.w == 0 || cell.h == 0) continue;
+        for(int row = 0; row < GLYPH_ROWS; ++row) {
+            // Runs of set columns become one span
+            for(int col = 0; col < 5;) {
+                if(!(glyph[col] >> row & 1)) { ++col; continue; }
+                int end = col;
+                while(end < 5 && glyph[end] >> row & 1) ++end;
+                _fill_rect(target, (yui_Rect){ x + col*scale, y + row*scale, (end - col)*scale, scale }, color);
+                col = end;
+            }
+        }
+    }
+}
+
+void yui_soft_begin_scissor_mode(yui_SoftTarget *target, yui_Rect rect)
+{
+    target->clip = _intersect(rect, (yui_Rect){ 0, 0, target->width, target->height });
+}
+
+void yui_soft_end_scissor_mode(yui_SoftTarget *target)
+{
+    target->clip = (yui_Rect){ 0, 0, target->width, target->height };
+}
+
+void yui_soft_render(yui_SoftTarget *target, const yui_DrawCommand *commands, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; ++i) {
+        const yui_DrawCommand *cmd = &commands[i];
+        switch(cmd->kind) {
+        case YUI_DRAW_RECT:
+            yui_soft_draw_rect(target, cmd->rect, cmd->color, cmd->roundness);
+            break;
+        case YUI_DRAW_RECT_OUTLINE:
+            yui_soft_draw_rect_outline(target, cmd->rect, cmd->color, cmd->border_width);
+            break;
+        case YUI_DRAW_TEXT:
+            yui_soft_draw_text(target, cmd->text.str, cmd->text.font_size, cmd->rect.x, cmd->rect.y, cmd->color);
+            break;
+        case YUI_DRAW_SCISSOR_PUSH:
+            yui_soft_begin_scissor_mode(target, cmd->rect);
+            break;
+        case YUI_DRAW_SCISSOR_POP:
+            if(cmd->restore) yui_soft_begin_scissor_mode(target, cmd->rect);
+            else yui_soft_end_scissor_mode(target);
+            break;
+        }
+    }
+}
+
+static _Thread_local yui_SoftTarget *bound_target;
+
+void yui_soft_bind(yui_SoftTarget *target)
+{
+    bound_target = target;
+}
+
+internal void _soft_draw_text(void *font, const char *text, int font_size, int x, int y, yui_Color tint)
+{
+    (void)font;
+    if(bound_target) yui_soft_draw_text(bound_target, text, font_size, x, y, tint);
+}
+
+internal void _soft_draw_rect(yui_Rect rect, yui_Color color, float roundness)
+{
+    if(bound_target) yui_soft_draw_rect(bound_target, rect, color, roundness);
+}
+
+internal void _soft_draw_rect_outline(yui_Rect rect, yui_Color color, int border_width)
+{
+    if(bound_target) yui_soft_draw_rect_outline(bound_target, rect, color, border_width);
+}
+
+internal void _soft_begin_scissor_mode(yui_Rect rect)
+{
+    if(bound_target) yui_soft_begin_scissor_mode(bound_target, rect);
+}
+
+internal void _soft_end_scissor_mode(void)
+{
+    if(bound_target) yui_soft_end_scissor_mode(bound_target);
+}
+
+void yui_soft_install(yui_Ctx *ctx)
+{
+    ctx->config.measure_text = yui_soft_measure_text;
+    ctx->config.draw_text    = _soft_draw_text;
+    ctx->config.draw_rect    = _soft_draw_rect;
+    ctx->config.draw_rect_outline  = _soft_draw_rect_outline;
+    ctx->config.begin_scissor_mode = _soft_begin_scissor_mode;
+    ctx->config.end_scissor_mode   = _soft_end_scissor_mode;
+}
@@ -0,0 +1,35 @@
+#ifndef YUI_SOFT_H_
+#define YUI_SOFT_H_
+
+#include "yui.h"
+
+// Software renderer into a caller owned RGBA8 framebuffer. Results are the same on
+// every CPU, the SSE2/AVX2 paths only change how many pixels are done per step,
+// YUI_SOFT_NO_SIMD turns them off.
+// Text uses a built-in 5x7 bitmap font scaled by font_size/8, the font pointer is ignored.
+typedef struct {
+    uint8_t *pixels;
+    int width;
+    int height;
+    int stride; // bytes per row
+    yui_Rect clip;
+} yui_SoftTarget;
+
+void yui_soft_init(yui_SoftTarget *target, void *pixels, int width, int height, int stride);
+void yui_soft_clear(yui_SoftTarget *target, yui_Color color);
+void yui_soft_draw_rect(yui_SoftTarget *target, yui_Rect rect, yui_Color color, float roundness);
+void yui_soft_draw_rect_outline(yui_SoftTarget *target, yui_Rect rect, yui_Color color, int border_width);
+void yui_soft_draw_text(yui_SoftTarget *target, const char *text, int font_size, int x, int y, yui_Color color);
+void yui_soft_begin_scissor_mode(yui_SoftTarget *target, yui_Rect rect);
+void yui_soft_end_scissor_mode(yui_SoftTarget *target);
+int  yui_soft_measure_text(void *font, const char *text, int font_size);
+
+// Draws a command list straight into the target, without going through ctx->config
+void yui_soft_render(yui_SoftTarget *target, const yui_DrawCommand *commands, uint32_t count);
+
+// Points ctx->config at the software renderer. The callbacks draw into the target
+// bound with yui_soft_bind on the calling thread.
+void yui_soft_install(yui_Ctx *ctx);
+void yui_soft_bind(yui_SoftTarget *target);
+
+#endif // YUI_SOFT_H_
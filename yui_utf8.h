@@ -0,0 +1,36 @@
+#ifndef YUI_UTF8_H_
+#define YUI_UTF8_H_
+
+#include <stdint.h>
+
+// Shared by yui.c and the backends that walk text themselves, so every one of them breaks
+// a string into the same codepoints.
+
+// Advances the string past one codepoint, invalid sequences are U+FFFD one byte at a time
+static inline uint32_t yui_decode_utf8(const unsigned char **str)
+{
+    const unsigned char *s = *str;
+    uint32_t c = s[0];
+    uint32_t length = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+    uint32_t min = length == 2 ? 0x80 : length == 3 ? 0x800 : 0x10000;
+    if(length == 0) {
+        *str = s + 1;
+        return 0xFFFD;
+    }
+    if(length == 1) {
+        *str = s + 1;
+        return c;
+    }
+    c &= 0x3F >> (length - 1);
+    for(uint32_t i = 1; i < length; ++i) {
+        if((s[i] & 0xC0) != 0x80) {
+            *str = s + 1;
+            return 0xFFFD;
+        }
+        c = c << 6 | (s[i] & 0x3F);
+    }
+    *str = s + length;
+    return c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF) ? 0xFFFD : c;
+}
+
+#endif // YUI_UTF8_H_